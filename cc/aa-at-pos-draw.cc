@@ -4,6 +4,7 @@
 #include "signature-page/aa-at-pos-draw.hh"
 #include "signature-page/tree.hh"
 #include "signature-page/tree-draw.hh"
+#include "signature-page/text-measure.hh"
 
 // ----------------------------------------------------------------------
 
@@ -195,13 +196,22 @@ void AAAtPosDraw::make_aa_pos_sections(bool init_settings, size_t hz_section_thr
 
 // ----------------------------------------------------------------------
 
-void AAAtPosDraw::draw(bool init_settings, size_t hz_section_threshold)
+void AAAtPosDraw::prepare_draw(bool init_settings, size_t hz_section_threshold)
 {
-    if (!positions_.empty()) {
+    if (!positions_.empty())
         make_aa_pos_sections(init_settings, hz_section_threshold); // must be here, after ladderrizing
+
+} // AAAtPosDraw::prepare_draw
+
+// ----------------------------------------------------------------------
+
+void AAAtPosDraw::draw()
+{
+    if (!positions_.empty()) {
         const auto surface_width = mSurface.viewport().size.width;
         const auto section_width = surface_width / static_cast<double>(positions_.size());
         const auto line_length = section_width * mSettings.line_length;
+        const Pixels line_width{*mSettings.line_width};
 
         auto draw_dash = [&, this](const Node& aNode) {
             const auto sequence = aNode.data.amino_acids();
@@ -210,18 +220,21 @@ void AAAtPosDraw::draw(bool init_settings, size_t hz_section_threshold)
                     const auto aa = sequence[pos];
                     const auto base_x = section_width * static_cast<double>(section_no) + (section_width - line_length) / 2;
                     const std::string aa_s(1, aa);
-                    mSurface.text({base_x, aNode.draw.vertical_pos + this->mSettings.line_width / 2}, aa_s, BLACK /* found->second */, Pixels{*this->mSettings.line_width});
+                    mSurface.text({base_x, aNode.draw.vertical_pos + line_width.value() / 2}, aa_s, BLACK /* found->second */, line_width);
                     if (const auto color_p = this->colors_[pos].find(aa); color_p != colors_[pos].end()) {
-                        const auto aa_width = mSurface.text_size(aa_s, Pixels{*this->mSettings.line_width}).width * 2;
-                        mSurface.line({base_x + aa_width, aNode.draw.vertical_pos}, {base_x + line_length - aa_width, aNode.draw.vertical_pos}, color_p->second, Pixels{*this->mSettings.line_width},
+                        const auto aa_width = measure_text(mSurface, aa_s, line_width).width * 2;
+                        mSurface.line({base_x + aa_width, aNode.draw.vertical_pos}, {base_x + line_length - aa_width, aNode.draw.vertical_pos}, color_p->second, line_width,
                                       acmacs::surface::LineCap::Round);
                     }
                 }
             }
         };
-        tree::iterate_leaf(mTree, draw_dash);
+        if (mSettings.run_length || mPreview)
+            draw_runs(section_width, line_length);
+        else
+            tree::iterate_leaf(mTree, draw_dash);
 
-        // const auto pos_text_height = mSurface.text_size("8", Pixels{}).height;
+        // const auto pos_text_height = measure_text(mSurface, "8", Pixels{}).height;
         for (size_t section_no = 0; section_no < positions_.size(); ++section_no) {
             const auto pos = positions_[section_no];
             mSurface.text({section_width * static_cast<double>(section_no) + section_width / 4, mSurface.viewport().size.height + 10}, std::to_string(pos + 1), BLACK, Pixels{line_length}, acmacs::TextStyle{},
@@ -235,6 +248,49 @@ void AAAtPosDraw::draw(bool init_settings, size_t hz_section_threshold)
 
 // ----------------------------------------------------------------------
 
+void AAAtPosDraw::draw_runs(double section_width, double line_length)
+{
+    std::vector<const Node*> leaves;
+    tree::iterate_leaf(mTree, [&leaves](const Node& aNode) {
+        if (aNode.draw.shown)
+            leaves.push_back(&aNode);
+    });
+
+    const auto line_width = mSurface.convert(Pixels{*mSettings.line_width}).value();
+    size_t runs = 0;
+    for (auto [section_no, pos] : acmacs::enumerate(positions_)) {
+        const auto aa_at = [pos = pos](const Node* aNode) -> char {
+            const auto sequence = aNode->data.amino_acids();
+            return pos < sequence.size() ? sequence[pos] : ' ';
+        };
+        const auto base_x = section_width * static_cast<double>(section_no) + (section_width - line_length) / 2;
+        for (auto first = leaves.begin(); first != leaves.end();) {
+            const auto aa = aa_at(*first);
+            auto next = std::next(first);
+            // run is broken by hz section gap
+            while (next != leaves.end() && aa_at(*next) == aa && (*next)->draw.hz_section_index == NodeDrawData::HzSectionNoIndex)
+                ++next;
+            if (aa != ' ') {
+                const auto top = (*first)->draw.vertical_pos - line_width / 2, bottom = (*std::prev(next))->draw.vertical_pos + line_width / 2;
+                const std::string aa_s(1, aa);
+                const auto aa_size = measure_text(mSurface, aa_s, Pixels{*mSettings.line_width});
+                if (!mPreview && (bottom - top) >= aa_size.height)
+                    mSurface.text({base_x, (top + bottom) / 2 + mSettings.line_width / 2}, aa_s, BLACK, Pixels{*mSettings.line_width});
+                if (const auto color_p = colors_[pos].find(aa); color_p != colors_[pos].end()) {
+                    const auto aa_width = aa_size.width * 2;
+                    mSurface.rectangle_filled({base_x + aa_width - line_width / 2, top}, acmacs::Size{line_length - aa_width * 2 + line_width, bottom - top}, color_p->second, Pixels{0}, color_p->second);
+                }
+                ++runs;
+            }
+            first = next;
+        }
+    }
+    fmt::print("INFO: aa-at-pos: {} runs drawn for {} leaves at {} positions\n", runs, leaves.size(), positions_.size());
+
+} // AAAtPosDraw::draw_runs
+
+// ----------------------------------------------------------------------
+
 void AAAtPosDraw::draw_hz_section_lines() const
 {
     const auto surface_width = mSurface.viewport().size.width;
@@ -42,6 +42,7 @@ class AAAtPosDrawSettings : public acmacs::settings::v1::object
     acmacs::settings::v1::field_array<size_t>            positions{this, "positions"};
     acmacs::settings::v1::field<bool>                    report_most_diverse_positions{this, "report_most_diverse_positions", false};
     acmacs::settings::v1::field<size_t>                  small_section_threshold{this, "small_section_threshold", 3}; // remove sections having this or fewer number of sequences
+    acmacs::settings::v1::field<bool>                    run_length{this, "run_length", false}; // consecutive leaves with the same aa at a position are drawn as one bar with one letter
     acmacs::settings::v1::field_array_of<AAAtPosSection> sections{this, "?sections"};
 
 }; // class AAAtPosDrawSettings
@@ -55,7 +56,9 @@ class AAAtPosDraw
         : mSurface(aSurface), mTree(aTree), mHzSections(aHzSections), mSettings(aSettings) {}
 
     void prepare();
-    void draw(bool init_settings, size_t hz_section_threshold);
+    void prepare_draw(bool init_settings, size_t hz_section_threshold);
+    void draw();
+    void preview(bool aPreview) { mPreview = aPreview; } // draw runs without letters
 
     acmacs::surface::Surface& surface() { return mSurface; }
 
@@ -67,11 +70,13 @@ class AAAtPosDraw
     std::vector<size_t> positions_;
     std::map<size_t, std::map<char, size_t>> aa_per_pos_;
     std::map<size_t, std::map<char, Color>> colors_;
+    bool mPreview = false;
 
     void collect_aa_per_pos();
     void find_most_diverse_positions();
     void set_colors();
     void draw_hz_section_lines() const;
+    void draw_runs(double section_width, double line_length);
     void make_aa_pos_sections(bool init_settings, size_t hz_section_threshold);
 
 }; // class AAAtPosDraw
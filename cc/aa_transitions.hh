@@ -3,6 +3,8 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <optional>
+#include <cstdint>
 
 // ----------------------------------------------------------------------
 
@@ -22,6 +24,24 @@ class AA_Transition
     operator bool() const { return !empty_left() && !left_right_same(); } // if transition is good for display
     friend inline std::ostream& operator<<(std::ostream& out, const AA_Transition& a) { return out << a.display_name(); }
 
+      // packed pos, left and right, the same code for the transition and its display_name()
+    uint32_t code() const { return code(pos, left, right); }
+    static uint32_t code(size_t aPos, char aLeft, char aRight) { return static_cast<uint32_t>(aPos) << 16 | static_cast<uint32_t>(static_cast<unsigned char>(aLeft)) << 8 | static_cast<unsigned char>(aRight); }
+    static std::optional<uint32_t> code(std::string_view aDisplayName) // e.g. N145K
+    {
+        if (aDisplayName.size() < 3)
+            return std::nullopt;
+        size_t pos = 0;
+        for (auto digit = std::next(aDisplayName.begin()); digit != std::prev(aDisplayName.end()); ++digit) {
+            if (*digit < '0' || *digit > '9')
+                return std::nullopt;
+            pos = pos * 10 + static_cast<size_t>(*digit - '0');
+        }
+        if (pos == 0)
+            return std::nullopt;
+        return code(pos - 1, aDisplayName.front(), aDisplayName.back());
+    }
+
     char left;
     char right;
     size_t pos;
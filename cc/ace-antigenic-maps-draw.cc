@@ -1,10 +1,14 @@
-#include <set>
+#include <unordered_map>
+#include <filesystem>
+#include <sstream>
 
 #include "acmacs-base/enumerate.hh"
+#include "acmacs-base/read-file.hh"
 #include "acmacs-base/color-gradient.hh"
 #include "acmacs-chart-2/serum-circle.hh"
 #include "acmacs-map-draw/vaccine-matcher.hh"
 #include "acmacs-map-draw/mod-applicator.hh"
+#include "signature-page/file-content.hh"
 #include "ace-antigenic-maps-draw.hh"
 #include "tree-draw.hh"
 #include "time-series-draw.hh"
@@ -136,6 +140,119 @@ void AntigenicMapsLayoutDrawAce::prepare_chart_for_all_sections()
 
 // ----------------------------------------------------------------------
 
+static inline double serum_circle_empirical_radius(size_t antigen_no, size_t serum_no, const acmacs::chart::Chart& chart)
+{
+    const auto circle_data = acmacs::chart::serum_circle_empirical(antigen_no, serum_no, chart, 0);
+    return circle_data.valid() ? circle_data.radius() : -1.0;
+
+} // serum_circle_empirical_radius
+
+// ----------------------------------------------------------------------
+
+void AntigenicMapsLayoutDrawAce::prepare_sections(const std::vector<size_t>& aSectionIndexes)
+{
+    bool tracked_serum_circles{false};
+    settings().mods.for_each([&tracked_serum_circles](const auto& mod, size_t /*mod_no*/) {
+        if (mod.name.is_set_or_has_default() && mod.name == "tracked_serum_circles")
+            tracked_serum_circles = true;
+    });
+    if (!tracked_serum_circles || antigenic_maps_draw().preview())
+        return;
+    load_serum_circle_radii();
+
+      // serum circle radii are the most expensive part of preparing maps and they do not depend on the chart drawing state,
+      // compute them once for all maps (the same antigen-serum pair is often tracked in several maps), mods are then applied to chart_draw() in the map order as before
+    std::vector<std::pair<size_t, size_t>> antigen_serum;
+    for (const auto section_index : aSectionIndexes) {
+        for (const auto& [serum_no, homologous_antigens] : tracked_sera(section_index)) { // sets homologous antigens in the chart
+            for (const auto antigen_no : homologous_antigens)
+                antigen_serum.emplace_back(antigen_no, serum_no);
+        }
+    }
+    std::sort(antigen_serum.begin(), antigen_serum.end());
+    antigen_serum.erase(std::unique(antigen_serum.begin(), antigen_serum.end()), antigen_serum.end());
+    antigen_serum.erase(std::remove_if(antigen_serum.begin(), antigen_serum.end(), [this](const auto& ag_sr) { return mSerumCircleRadius.find(ag_sr) != mSerumCircleRadius.end(); }), antigen_serum.end());
+    if (antigen_serum.empty())
+        return;
+
+    for (const auto& ag_sr : antigen_serum)
+        mSerumCircleRadius.emplace(ag_sr, serum_circle_empirical_radius(ag_sr.first, ag_sr.second, chart()));
+    fmt::print("INFO: serum circle radii computed: {}\n", antigen_serum.size());
+    save_serum_circle_radii();
+
+} // AntigenicMapsLayoutDrawAce::prepare_sections
+
+// ----------------------------------------------------------------------
+
+// Empirical serum circle radii depend only on the chart, they are stored next to the chart together with the chart content hash
+// and reused by the next runs over the same chart. Radii computed for "serum_circle" and "tracked_serum_circles" mods are stored.
+
+void AntigenicMapsLayoutDrawAce::load_serum_circle_radii()
+{
+    if (!mSerumCircleRadiiStamp.empty())
+        return;
+    const auto filename = serum_circle_radii_filename();
+    try {
+        mSerumCircleRadiiStamp = file_content::stamp(chart_draw_interface().filename());
+        if (std::filesystem::exists(filename)) {
+            std::istringstream content{acmacs::file::read(filename)};
+            if (std::string line; std::getline(content, line) && line == mSerumCircleRadiiStamp) { // otherwise chart was changed, stored radii are invalid
+                while (std::getline(content, line)) {
+                    std::istringstream fields{line};
+                    size_t antigen_no, serum_no;
+                    double radius;
+                    if (fields >> antigen_no >> serum_no >> radius)
+                        mSerumCircleRadius.emplace(std::pair{antigen_no, serum_no}, radius);
+                }
+                mSerumCircleRadiiStored = mSerumCircleRadius.size();
+                fmt::print("INFO: serum circle radii read from {}: {}\n", filename, mSerumCircleRadiiStored);
+            }
+            else
+                fmt::print("INFO: {} is outdated\n", filename);
+        }
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "WARNING: cannot read {}: {}\n", filename, err.what());
+    }
+
+} // AntigenicMapsLayoutDrawAce::load_serum_circle_radii
+
+// ----------------------------------------------------------------------
+
+void AntigenicMapsLayoutDrawAce::save_serum_circle_radii()
+{
+    if (mSerumCircleRadiiStamp.empty() || mSerumCircleRadius.size() == mSerumCircleRadiiStored)
+        return;
+    const auto filename = serum_circle_radii_filename();
+    try {
+        std::string content = mSerumCircleRadiiStamp + '\n';
+        for (const auto& [antigen_serum, radius] : mSerumCircleRadius)
+            content += fmt::format("{}\t{}\t{}\n", antigen_serum.first, antigen_serum.second, radius);
+        file_content::write_replacing(filename, content); // the same chart may be drawn by several sigp --batch jobs at the same time
+        mSerumCircleRadiiStored = mSerumCircleRadius.size();
+        fmt::print("INFO: serum circle radii written to {}: {}\n", filename, mSerumCircleRadiiStored);
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "WARNING: cannot write {}: {}\n", filename, err.what());
+        mSerumCircleRadiiStamp.clear();
+    }
+
+} // AntigenicMapsLayoutDrawAce::save_serum_circle_radii
+
+// ----------------------------------------------------------------------
+
+double AntigenicMapsLayoutDrawAce::serum_circle_radius(size_t antigen_no, size_t serum_no)
+{
+    if (const auto found = mSerumCircleRadius.find({antigen_no, serum_no}); found != mSerumCircleRadius.end())
+        return found->second;
+    const auto radius = serum_circle_empirical_radius(antigen_no, serum_no, chart());
+    mSerumCircleRadius.emplace(std::pair{antigen_no, serum_no}, radius);
+    return radius;
+
+} // AntigenicMapsLayoutDrawAce::serum_circle_radius
+
+// ----------------------------------------------------------------------
+
 void AntigenicMapsLayoutDrawAce::prepare_drawing_chart(size_t aSectionIndex, std::string map_letter, bool report_antigens_in_hz_sections)
 {
     // reset tracked antigens and sera shown on the previous map
@@ -222,10 +339,12 @@ void AntigenicMapsLayoutDrawAce::prepare_drawing_chart(size_t aSectionIndex, std
                     make_tracked_serum(serum_index, Pixels{mod.size.get_or(5.0)}, mod.outline.get_or(BLACK), Pixels{mod.outline_width.get_or(0.5)}, *mod.label);
             }
             else if (mod.name == "tracked_serum_circles") {
-                tracked_serum_circles(mod, aSectionIndex);
+                if (!antigenic_maps_draw().preview())
+                    tracked_serum_circles(mod, aSectionIndex);
             }
             else if (mod.name == "serum_circle") {
-                serum_circle(mod, map_letter, aSectionIndex);
+                if (!antigenic_maps_draw().preview())
+                    serum_circle(mod, map_letter, aSectionIndex);
             }
             else if (mod.name == "vaccines") {
                 throw std::runtime_error("obsolete mod \"vaccines\" (use {\"N\":\"antigens\", \"select\": {\"vaccine\": }}): " + mod.to_json());
@@ -408,17 +527,47 @@ void AntigenicMapsLayoutDrawAce::make_tracked_serum(size_t serum_index, Pixels s
 
 // ----------------------------------------------------------------------
 
+void AntigenicMapsLayoutDrawAce::find_sequenced_antigens()
+{
+    AntigenicMapsLayoutDraw::find_sequenced_antigens();
+
+    std::unordered_map<std::string, std::vector<size_t>> sera_by_name;
+    for (size_t serum_no = 0; serum_no < chart().number_of_sera(); ++serum_no)
+        sera_by_name[*chart().serum(serum_no)->name()].push_back(serum_no);
+
+    mSequencedAntigenData.assign(chart().number_of_antigens(), SequencedAntigenData{});
+    for (const auto& sequenced : sequenced_antigens()) {
+        auto antigen = chart().antigen(sequenced.first);
+        auto& data = mSequencedAntigenData[sequenced.first];
+        if (const auto date = antigen->date(); !date.empty() && date.size() >= 7)
+            data.month = date->substr(0, 7);
+        data.egg = antigen->passage().is_egg();
+        data.cell = antigen->passage().is_cell();
+        if (const auto found = sera_by_name.find(*antigen->name()); found != sera_by_name.end())
+            data.sera = found->second;
+    }
+
+} // AntigenicMapsLayoutDrawAce::find_sequenced_antigens
+
+// ----------------------------------------------------------------------
+
+bool AntigenicMapsLayoutDrawAce::passage_matches(size_t antigen_no, passage_t passage) const
+{
+    const auto& data = mSequencedAntigenData[antigen_no];
+    return passage == passage_t::all || (passage == passage_t::egg && data.egg) || (passage == passage_t::cell && data.cell);
+
+} // AntigenicMapsLayoutDrawAce::passage_matches
+
+// ----------------------------------------------------------------------
+
 acmacs::chart::PointIndexList AntigenicMapsLayoutDrawAce::tracked_antigens(size_t aSectionIndex, bool report_antigens_in_hz_sections, passage_t passage) const
 {
     acmacs::chart::PointIndexList tracked_indices;
-    for (const auto& sequenced_section : sequenced_antigens()) {
-        if (sequenced_section.second.section_index == aSectionIndex) {
-            auto antigen = chart().antigen(sequenced_section.first);
-            if (passage == passage_t::all || (passage == passage_t::egg && antigen->passage().is_egg()) || (passage == passage_t::cell && antigen->passage().is_cell())) {
-                tracked_indices.insert(sequenced_section.first);
-                if (report_antigens_in_hz_sections)
-                    std::cout << aSectionIndex << ' ' << sequenced_section.first << ' ' << antigen->name_full() << '\n';
-            }
+    for (const auto antigen_no : section_antigens(aSectionIndex)) {
+        if (passage_matches(antigen_no, passage)) {
+            tracked_indices.insert(antigen_no);
+            if (report_antigens_in_hz_sections)
+                std::cout << aSectionIndex << ' ' << antigen_no << ' ' << chart().antigen(antigen_no)->name_full() << '\n';
         }
     }
     return tracked_indices;
@@ -430,18 +579,14 @@ acmacs::chart::PointIndexList AntigenicMapsLayoutDrawAce::tracked_antigens(size_
 std::map<std::string, acmacs::chart::PointIndexList> AntigenicMapsLayoutDrawAce::tracked_antigens_per_month(size_t aSectionIndex, bool report_antigens_in_hz_sections, passage_t passage) const
 {
     std::map<std::string, acmacs::chart::PointIndexList> tracked_indices;
-    for (const auto& sequenced_section: sequenced_antigens()) {
-        if (sequenced_section.second.section_index == aSectionIndex) {
-            auto antigen = chart().antigen(sequenced_section.first);
-            if (const auto date = antigen->date(); !date.empty() && date.size() >= 7 && (passage == passage_t::all || (passage == passage_t::egg && antigen->passage().is_egg()) || (passage == passage_t::cell && antigen->passage().is_cell()))) {
-                const auto month = date->substr(0, 7);
-                tracked_indices[month].insert(sequenced_section.first);
-                if (report_antigens_in_hz_sections) {
-                    fmt::print(stderr, "AG {:4d} {}", sequenced_section.first, antigen->name_full());
-                    if (const auto* clades = sequenced_section.second.node->data.clades(); clades)
-                        fmt::print(stderr, "{}", *clades);
-                    fmt::print(stderr, "\n");
-                }
+    for (const auto antigen_no : section_antigens(aSectionIndex)) {
+        if (const auto& month = mSequencedAntigenData[antigen_no].month; !month.empty() && passage_matches(antigen_no, passage)) {
+            tracked_indices[month].insert(antigen_no);
+            if (report_antigens_in_hz_sections) {
+                fmt::print(stderr, "AG {:4d} {}", antigen_no, chart().antigen(antigen_no)->name_full());
+                if (const auto* clades = sequenced_antigens().at(antigen_no).node->data.clades(); clades)
+                    fmt::print(stderr, "{}", *clades);
+                fmt::print(stderr, "\n");
             }
         }
     }
@@ -484,25 +629,16 @@ std::map<size_t, acmacs::chart::PointIndexList> AntigenicMapsLayoutDrawAce::trac
 {
     find_homologous_antigens_for_sera();
 
-    const auto tracked_antigen_indices = tracked_antigens(aSectionIndex, false);
-    std::set<std::string> tracked_antigen_names;
-    for (auto ag_no : tracked_antigen_indices)
-        tracked_antigen_names.insert(*chart().antigen(ag_no)->name());
-
-    // std::cerr << "DEBUG: section " << aSectionIndex << " tracked antigen names " << tracked_antigen_names.size() << '\n';
-    // for (const auto& name : tracked_antigen_names)
-    //     std::cerr << "    " << name << '\n';
-
-    // std::cerr << "DEBUG: section " << aSectionIndex << " tracked antigens " << tracked_antigen_indices << '\n';
-    // std::cerr << "DEBUG: section " << aSectionIndex << " tracked antigens " << tracked_antigen_indices.size() << '\n';
-    // for (auto ag_no : tracked_antigen_indices)
-    //     std::cerr << "    " << ag_no << ' ' << chart().antigen(ag_no)->name_full() << '\n';
-
+      // sera having the same name as any antigen in the section, see find_sequenced_antigens()
     std::map<size_t, acmacs::chart::PointIndexList> tracked_indices;
-    for (size_t serum_no = 0; serum_no < chart().number_of_sera(); ++serum_no) {
-        if (tracked_antigen_names.find(*chart().serum(serum_no)->name()) != tracked_antigen_names.end()) {
-            if (const auto homologous_antigens_for_serum = chart().serum(serum_no)->homologous_antigens(); !homologous_antigens_for_serum->empty())
-                tracked_indices[serum_no] = homologous_antigens_for_serum;
+    std::vector<bool> serum_checked(chart().number_of_sera(), false);
+    for (const auto antigen_no : section_antigens(aSectionIndex)) {
+        for (const auto serum_no : mSequencedAntigenData[antigen_no].sera) {
+            if (!serum_checked[serum_no]) {
+                serum_checked[serum_no] = true;
+                if (const auto homologous_antigens_for_serum = chart().serum(serum_no)->homologous_antigens(); !homologous_antigens_for_serum->empty())
+                    tracked_indices[serum_no] = homologous_antigens_for_serum;
+            }
         }
     }
     return tracked_indices;
@@ -586,10 +722,7 @@ bool AntigenicMapsLayoutDrawAce::make_serum_circle(const AntigenicMapMod& mod, s
     };
 
     std::vector<double> radii(homologous_antigens->size());
-    std::transform(homologous_antigens.begin(), homologous_antigens.end(), radii.begin(), [&](size_t ag_no) -> double {
-        const auto circle_data = acmacs::chart::serum_circle_empirical(ag_no, serum_no, chart(), 0);
-        return circle_data.valid() ? circle_data.radius() : -1.0;
-    });
+    std::transform(homologous_antigens.begin(), homologous_antigens.end(), radii.begin(), [&](size_t ag_no) -> double { return serum_circle_radius(ag_no, serum_no); });
     std::sort(radii.begin(), radii.end());
 
     auto serum = chart().serum(serum_no);
@@ -649,7 +782,10 @@ void AntigenicMapsLayoutDrawAce::serum_circle(const AntigenicMapMod& mod, std::s
         if (!serum_index)
             throw std::runtime_error("serum not found: " + mod.to_json());
         const auto homologous_antigens_for_serum = chart().serum(*serum_index)->homologous_antigens();
-        if (make_serum_circle(mod, *serum_index, homologous_antigens_for_serum)) {
+        load_serum_circle_radii();
+        const bool shown = make_serum_circle(mod, *serum_index, homologous_antigens_for_serum);
+        save_serum_circle_radii(); // does nothing if radii were not computed
+        if (shown) {
             // const auto serum_outline = mod.serum_outline.get_or(serum_circle_outline(mod, chart().serum(*serum_index)->passage().is_egg(), false));
             const auto serum_outline = serum_circle_outline(mod, chart().serum(*serum_index)->is_egg(acmacs::chart::reassortant_as_egg::yes), false);
             // std::cerr << "DEBUG: serum_outline " << *serum_index << " " << chart().serum(*serum_index)->name_full() << " : " << serum_outline << '\n';
@@ -6,6 +6,7 @@
 #include "acmacs-map-draw/draw.hh"
 #include "antigenic-maps-draw.hh"
 #include "chart-draw.hh"
+#include "chart-cache.hh"
 #include "antigenic-maps-layout.hh"
 
 // ----------------------------------------------------------------------
@@ -13,7 +14,7 @@
 class ChartDrawInterface : public ChartDrawBase
 {
  public:
-    ChartDrawInterface(std::string_view chart_filename) : mChartDraw(chart_filename, 0) {}
+    ChartDrawInterface(std::string_view chart_filename) : mFilename(chart_filename), mChartDraw(std::make_shared<acmacs::chart::ChartModify>(chart_cache::import(chart_filename)), 0) {}
 
     void init_settings() override;
     const acmacs::Viewport& viewport() const override { return mChartDraw.viewport("signature-page ChartDrawInterface::viewport"); }
@@ -28,8 +29,10 @@ class ChartDrawInterface : public ChartDrawBase
     const acmacs::chart::Chart& chart() const override { return mChartDraw.chart(); }
     ChartDraw& chart_draw() { return mChartDraw; }
     const ChartDraw& chart_draw() const { return mChartDraw; }
+    const std::string& filename() const { return mFilename; }
 
  private:
+    std::string mFilename;
     ChartDraw mChartDraw;
 
 }; // class ChartDrawInterface
@@ -64,14 +67,30 @@ class AntigenicMapsLayoutDrawAce : public AntigenicMapsLayoutDraw
     void draw_chart(acmacs::surface::Surface& aSurface, size_t aSectionIndex) override;
     void prepare_apply_mods() override;
     void prepare_chart_for_all_sections() override;
+    void prepare_sections(const std::vector<size_t>& aSectionIndexes) override;
     void prepare_drawing_chart(size_t aSectionIndex, std::string map_letter, bool report_antigens_in_hz_sections) override;
 
+ protected:
+    void find_sequenced_antigens() override;
+
  private:
+    struct SequencedAntigenData  // chart data for sequenced antigens read once by find_sequenced_antigens()
+    {
+        std::string month;       // empty if antigen date is unknown
+        bool egg = false;
+        bool cell = false;
+        std::vector<size_t> sera; // sera having the same name
+    };
+
     mutable bool mHomologousAntigenForSeraFound;
     mutable std::map<std::string, Color, std::less<>> mTrackedAntigenColorByMonth;
     mutable Color mTooOldTrackedAntigenColor, mTooRecentTrackedAntigenColor;
     bool mColorScalePanelDrawn{false};
     mutable bool mAllSeraReported{false};
+    std::vector<SequencedAntigenData> mSequencedAntigenData;         // indexed by antigen_no
+    std::map<std::pair<size_t, size_t>, double> mSerumCircleRadius; // (antigen_no, serum_no) -> empirical radius, negative if not calculated
+    std::string mSerumCircleRadiiStamp;                              // chart content hash, empty if radii were not loaded
+    size_t mSerumCircleRadiiStored{0};                               // number of radii in the sidecar file
 
     const ChartDrawInterface& chart_draw_interface() const { return dynamic_cast<const ChartDrawInterface&>(antigenic_maps_draw().chart()); }
     ChartDrawInterface& chart_draw_interface() { return dynamic_cast<ChartDrawInterface&>(antigenic_maps_draw().chart()); }
@@ -80,6 +99,7 @@ class AntigenicMapsLayoutDrawAce : public AntigenicMapsLayoutDraw
     ChartDraw& chart_draw() { return chart_draw_interface().chart_draw(); }
 
     enum class passage_t { all, egg, cell };
+    bool passage_matches(size_t antigen_no, passage_t passage) const;
     acmacs::chart::PointIndexList tracked_antigens(size_t aSectionIndex, bool report_antigens_in_hz_sections, passage_t passage = passage_t::all) const;
     std::map<std::string, acmacs::chart::PointIndexList> tracked_antigens_per_month(size_t aSectionIndex, bool report_antigens_in_hz_sections, passage_t passage = passage_t::all) const;
     Color tracked_antigen_color_by_month(std::string_view month) const;
@@ -95,6 +115,10 @@ class AntigenicMapsLayoutDrawAce : public AntigenicMapsLayoutDraw
 
     // returns if circle shown
     bool make_serum_circle(const AntigenicMapMod& mod, size_t serum_no, const acmacs::chart::PointIndexList& homologous_antigens);
+    double serum_circle_radius(size_t antigen_no, size_t serum_no);
+    std::string serum_circle_radii_filename() const { return chart_draw_interface().filename() + ".serum-circles.tsv"; }
+    void load_serum_circle_radii();
+    void save_serum_circle_radii();
     void make_tracked_serum(size_t serum_index, Pixels size, Color outline, Pixels outline_width, const LabelSettings& label_data);
     void find_homologous_antigens_for_sera() const;
     Color serum_circle_outline(const AntigenicMapMod& mod, bool egg, bool forced_radius) const;
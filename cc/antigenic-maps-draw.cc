@@ -1,4 +1,5 @@
 #include <typeinfo>
+#include <algorithm>
 
 #include "acmacs-chart-2/factory-import.hh"
 #include "tree-draw.hh"
@@ -57,22 +58,8 @@ void AntigenicMapsDrawBase::init_settings(const SettingsInitializer& settings_in
           break;
     }
     const size_t maps_per_column = number_sections / settings().columns + ((number_sections % settings().columns) == 0 ? 0 : 1);
-    const double map_width = 150; // height is not available at this moment mSurface.viewport().size.height / (maps_per_column + settings().gap * (maps_per_column - 1));
-    signature_page_settings().antigenic_maps_width = map_width * static_cast<double>(settings().columns) + static_cast<double>(settings().columns - 1) * settings().gap;
-    switch (settings().columns) {
-      case 2:
-          switch (maps_per_column) {
-            case 2:
-              signature_page_settings().antigenic_maps_width = 579;
-              break;
-          }
-          break;
-      case 3:
-          signature_page_settings().antigenic_maps_width = 579;
-          break;
-    }
-
-    std::cout << "INFO: antigenic maps: columns:" << settings().columns << " maps_per_column:" << maps_per_column << " map_width:" << map_width << " width:" << signature_page_settings().antigenic_maps_width << '\n';
+      // antigenic_maps_width is not set here, it is solved in prepare (see solve_grid()) and then written to the initialized settings
+    std::cout << "INFO: antigenic maps: columns:" << settings().columns << " maps_per_column:" << maps_per_column << '\n';
 
     if (!mLayout)
         make_layout();
@@ -91,6 +78,69 @@ void AntigenicMapsDrawBase::draw(acmacs::surface::Surface& aMappedAntigensDrawSu
 
 // ----------------------------------------------------------------------
 
+AntigenicMapsGrid solve_antigenic_maps_grid(size_t aMaps, size_t aColumns, double aGap, double aHeight, double aMaxWidth)
+{
+    const auto solve = [=](size_t columns) {
+        AntigenicMapsGrid grid;
+        grid.columns = columns;
+        grid.rows = aMaps / columns + ((aMaps % columns) ? 1 : 0);
+        const double cell_by_height = (aHeight - static_cast<double>(grid.rows - 1) * aGap) / static_cast<double>(grid.rows);
+        const double cell_by_width = (aMaxWidth - static_cast<double>(columns - 1) * aGap) / static_cast<double>(columns);
+        grid.cell = std::max(std::min(cell_by_height, cell_by_width), 0.0);
+        grid.width = grid.cell * static_cast<double>(columns) + static_cast<double>(columns - 1) * aGap;
+        grid.height = grid.cell * static_cast<double>(grid.rows) + static_cast<double>(grid.rows - 1) * aGap;
+        return grid;
+    };
+
+    if (aMaps == 0)
+        return AntigenicMapsGrid{};
+    if (aColumns > 0)
+        return solve(aColumns);
+    AntigenicMapsGrid best = solve(1);
+    for (size_t columns = 2; columns <= aMaps; ++columns) {
+        if (const auto grid = solve(columns); grid.cell > best.cell) // fewer columns preferred for the same cell size
+            best = grid;
+    }
+    return best;
+
+} // solve_antigenic_maps_grid
+
+// ----------------------------------------------------------------------
+
+double AntigenicMapsDrawBase::solve_grid(double aHeight, double aMaxWidth)
+{
+    const auto& node_refs = hz_sections().node_refs; // made final by TreeDraw::prepare_sections()
+    const size_t maps = static_cast<size_t>(std::count_if(node_refs.begin(), node_refs.end(), [](const auto& node_ref) { return !node_ref.index.empty(); }));
+    if (maps == 0) {
+        if (settings().columns == 0)
+            settings().columns = 1;
+        return signature_page_settings().antigenic_maps_width.get_or(aMaxWidth);
+    }
+
+    const bool width_auto = signature_page_settings().antigenic_maps_width_auto || !signature_page_settings().antigenic_maps_width.is_set();
+    const double width = width_auto ? aMaxWidth : static_cast<double>(signature_page_settings().antigenic_maps_width);
+    const auto grid = solve_antigenic_maps_grid(maps, settings().columns, settings().gap, aHeight, width);
+    if (grid.cell <= 0.0)
+        throw std::runtime_error("antigenic maps do not fit: maps:" + std::to_string(maps) + " height:" + std::to_string(aHeight) + " width:" + std::to_string(width));
+    if (settings().columns == 0)
+        settings().columns = grid.columns;
+    if (width_auto) {
+        signature_page_settings().antigenic_maps_width = grid.width;
+        std::cout << "INFO: antigenic maps grid: maps:" << maps << " columns:" << grid.columns << " rows:" << grid.rows << " cell:" << grid.cell << " width:" << grid.width << " height:" << grid.height << '\n';
+        return grid.width;
+    }
+    else {
+        const double cell = (width - static_cast<double>(grid.columns - 1) * settings().gap) / static_cast<double>(grid.columns);
+        if (grid.cell < cell)
+            std::cerr << "WARNING: antigenic maps do not fit page height " << aHeight << " with antigenic_maps_width " << width << ", width fitting the page: " << grid.width
+                      << " (use signature_page.antigenic_maps_width_auto)\n";
+        return width;
+    }
+
+} // AntigenicMapsDrawBase::solve_grid
+
+// ----------------------------------------------------------------------
+
 void AntigenicMapsDrawBase::prepare()
 {
     // std::cerr << "DEBUG: AntigenicMapsDrawBase::prepare" << '\n';
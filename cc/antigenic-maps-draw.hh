@@ -27,6 +27,18 @@ class SettingsInitializer;
 
 // ----------------------------------------------------------------------
 
+// Square map cells of the labelled grid: the largest cell such that all maps fit into aHeight x aMaxWidth
+// aColumns == 0 means trying every number of columns and using the one giving the largest cell
+struct AntigenicMapsGrid
+{
+    size_t columns = 1, rows = 0;
+    double cell = 0, width = 0, height = 0;
+};
+
+AntigenicMapsGrid solve_antigenic_maps_grid(size_t aMaps, size_t aColumns, double aGap, double aHeight, double aMaxWidth);
+
+// ----------------------------------------------------------------------
+
 class AntigenicMapsDrawBase
 {
  public:
@@ -34,6 +46,7 @@ class AntigenicMapsDrawBase
     virtual ~AntigenicMapsDrawBase();
 
     virtual void init_settings(const SettingsInitializer& settings_initilizer);
+    double solve_grid(double aHeight, double aMaxWidth); // after hz sections are lettered by HzSections::sort(), returns antigenic maps width, updates settings if auto
     virtual void prepare();
     virtual void draw(acmacs::surface::Surface& aMappedAntigensDrawSurface, bool report_antigens_in_hz_sections);
     virtual ChartDrawBase& chart() = 0;
@@ -49,6 +62,8 @@ class AntigenicMapsDrawBase
     TimeSeriesDraw& time_series()  { return mTimeSeriesDraw; }
     AntigenicMapsDrawSettings& settings() { return mSettings; }
     const AntigenicMapsDrawSettings& settings() const { return mSettings; }
+    void preview(bool aPreview) { mPreview = aPreview; } // serum circles are not drawn
+    bool preview() const { return mPreview; }
 
     AntigenicMapsLayout& layout() { return *mLayout; }
       // const AntigenicMapsLayout& layout() const { return *mLayout; }
@@ -65,6 +80,7 @@ class AntigenicMapsDrawBase
     TimeSeriesDraw& mTimeSeriesDraw;
     AntigenicMapsDrawSettings& mSettings;
     std::unique_ptr<AntigenicMapsLayout> mLayout;
+    bool mPreview = false;
 
 }; // class AntigenicMapsDrawBase
 
@@ -288,7 +304,7 @@ class AntigenicMapsDrawSettings : public acmacs::settings::v1::object
     AntigenicMapsDrawSettings(acmacs::settings::v1::base& parent);
 
     acmacs::settings::v1::field<std::string>              layout{this, "layout", "labelled_grid"};
-    acmacs::settings::v1::field<size_t>                   columns{this, "columns", 3};
+    acmacs::settings::v1::field<size_t>                   columns{this, "columns", 3}; // 0: chosen by the grid solver, see AntigenicMapsDrawBase::solve_grid()
     acmacs::settings::v1::field<double>                   gap{this, "gap", 20};
     acmacs::settings::v1::field<Color>                    mapped_antigens_section_line_color{this, "mapped_antigens_section_line_color", BLACK};
     acmacs::settings::v1::field<double>                   mapped_antigens_section_line_width{this, "mapped_antigens_section_line_width", 1};
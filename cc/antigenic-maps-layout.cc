@@ -93,15 +93,38 @@ void AntigenicMapsLayoutDraw::find_sequenced_antigens()
 
     tree::iterate_leaf(mAntigenicMapsDraw.tree(), find_antigens);
 
-    std::vector<size_t> antigens_per_section(20);
-    for (auto ag_sec : mSequencedAntigens)
-        ++antigens_per_section[ag_sec.second.section_index];
+    mSectionAntigens.clear();
+    for (const auto& [antigen_no, sequenced] : mSequencedAntigens) {
+        if (sequenced.section_index != NodeDrawData::HzSectionNoIndex) {
+            if (mSectionAntigens.size() <= sequenced.section_index)
+                mSectionAntigens.resize(sequenced.section_index + 1);
+            mSectionAntigens[sequenced.section_index].push_back(antigen_no);
+        }
+    }
+
+    std::vector<size_t> antigens_per_section(mSectionAntigens.size());
+    std::transform(mSectionAntigens.begin(), mSectionAntigens.end(), antigens_per_section.begin(), [](const auto& antigens) { return antigens.size(); });
     AD_DEBUG("antigens_per_section: {}", antigens_per_section);
 
 } // AntigenicMapsLayoutDraw::find_sequenced_antigens
 
 // ----------------------------------------------------------------------
 
+const std::vector<size_t>& AntigenicMapsLayoutDraw::section_antigens(size_t aSectionIndex) const
+{
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wexit-time-destructors"
+#endif
+    static const std::vector<size_t> no_antigens;
+#pragma GCC diagnostic pop
+
+    return aSectionIndex < mSectionAntigens.size() ? mSectionAntigens[aSectionIndex] : no_antigens;
+
+} // AntigenicMapsLayoutDraw::section_antigens
+
+// ----------------------------------------------------------------------
+
 AntigenicMapsLayout::~AntigenicMapsLayout()
 {
 } // AntigenicMapsLayout::~AntigenicMapsLayout
@@ -119,6 +142,13 @@ void LabelledGridBase::draw(acmacs::surface::Surface& aMappedAntigensDrawSurface
 
     const double map_width = (surface.viewport().size.width - static_cast<double>(settings.columns - 1) * settings.gap) / static_cast<double>(settings.columns);
 
+    std::vector<size_t> shown_sections;
+    for (const auto section_index: layout_draw().hz_sections().section_order) {
+        if (const auto& section = layout_draw().hz_sections().sections[section_index]; section->show && section->show_map)
+            shown_sections.push_back(section_index);
+    }
+    layout_draw().prepare_sections(shown_sections);
+
     size_t shown_maps = 0, row = 0, column = 0;
     for (const auto section_index: layout_draw().hz_sections().section_order) {
         const auto& section = layout_draw().hz_sections().sections[section_index];
@@ -143,23 +173,8 @@ void LabelledGridBase::draw(acmacs::surface::Surface& aMappedAntigensDrawSurface
         }
     }
 
-    if (shown_maps) {
-        const double antigenic_maps_width = layout_draw().signature_page_settings().antigenic_maps_width;
-        const size_t rows = shown_maps / settings.columns + ((shown_maps % settings.columns) ? 1 : 0);
-        const double maps_height = map_width * static_cast<double>(rows) + static_cast<double>(rows - 1) * settings.gap;
-        const double suggested_surface_width = antigenic_maps_width * surface.viewport().size.height / maps_height;
-        std::cout << "Map area height: " << maps_height << '\n';
-        if (std::abs((antigenic_maps_width - suggested_surface_width) / antigenic_maps_width) > 1) {
-            std::cout << "Change signature_page.antigenic_maps_width from " << antigenic_maps_width << " to " << suggested_surface_width << '\n'
-                      << "  If you use --init-settings changed width will be saved there" << '\n';
-            layout_draw().signature_page_settings().antigenic_maps_width = suggested_surface_width;
-        }
-        else
-            std::cout << "antigenic_maps.width is OK: " << antigenic_maps_width << " vs. suggested " << suggested_surface_width << '\n';
-    }
-    else {
+    if (!shown_maps)
         std::cerr << "WARNING: no maps shown!\n";
-    }
 
 } // LabelledGridBase::draw
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 
 #include "acmacs-draw/viewport.hh"
 #include "antigenic-maps-draw.hh"
@@ -20,6 +21,7 @@ class AntigenicMapsLayoutDraw
     virtual void prepare();
     virtual void prepare_apply_mods() = 0;
     virtual void prepare_chart_for_all_sections() = 0;
+    virtual void prepare_sections(const std::vector<size_t>& /*aSectionIndexes*/) {} // data for shown maps not depending on the chart drawing state
     virtual void prepare_drawing_chart(size_t aSectionIndex, std::string map_letter, bool report_antigens_in_hz_sections) = 0;
     virtual void draw_chart(acmacs::surface::Surface& aSurface, size_t aSectionIndex) = 0;
 
@@ -42,6 +44,7 @@ class AntigenicMapsLayoutDraw
     };
 
     const auto& sequenced_antigens() const { return mSequencedAntigens; }
+    const std::vector<size_t>& section_antigens(size_t aSectionIndex) const; // sorted antigen indexes of sequenced antigens in hz section
 
  protected:
     virtual void apply_mods_before(acmacs::surface::Surface& aSurface);
@@ -52,6 +55,7 @@ class AntigenicMapsLayoutDraw
  private:
     AntigenicMapsDrawBase& mAntigenicMapsDraw;
     std::map<size_t, sequenced_antigen_t> mSequencedAntigens; // antigen_no to section_no
+    std::vector<std::vector<size_t>> mSectionAntigens;        // section_no to antigen_no list
 
 }; // class AntigenicMapsLayoutDraw
 
@@ -0,0 +1,71 @@
+#include <filesystem>
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-base/read-file.hh"
+#include "acmacs-chart-2/chart-modify.hh"
+#include "acmacs-chart-2/factory-import.hh"
+#include "acmacs-chart-2/factory-export.hh"
+#include "signature-page/file-content.hh"
+#include "signature-page/chart-cache.hh"
+
+// ----------------------------------------------------------------------
+
+static constexpr const char* CHART_CACHE_VERSION = "chart-cache-v1";
+
+static std::string& cache_dir()
+{
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wexit-time-destructors"
+#endif
+    static std::string dir;
+#pragma GCC diagnostic pop
+    return dir;
+}
+
+void chart_cache::setup(std::string_view aCacheDir)
+{
+    ::cache_dir().assign(aCacheDir);
+
+} // chart_cache::setup
+
+// ----------------------------------------------------------------------
+
+std::shared_ptr<acmacs::chart::Chart> chart_cache::import(std::string_view aFilename)
+{
+    const auto& dir = ::cache_dir();
+    if (dir.empty())
+        return acmacs::chart::import_from_file(aFilename);
+
+      // snapshot name is made of the chart file content size and hash, i.e. a changed chart file never matches an old snapshot
+    const auto content = file_content::read_raw(aFilename);
+    const auto snapshot = fmt::format("{}/{}-{:016x}.{}.json", dir, content.size(), file_content::hash(content), CHART_CACHE_VERSION);
+
+    if (std::filesystem::exists(snapshot)) {
+        try {
+            return acmacs::chart::import_from_data(acmacs::file::read(snapshot), acmacs::chart::Verify::None, report_time::no);
+        }
+        catch (std::exception& err) {
+            fmt::print(stderr, "WARNING: cannot import chart snapshot {}: {}\n", snapshot, err.what());
+        }
+    }
+
+    auto chart = std::make_shared<acmacs::chart::ChartModify>(acmacs::chart::import_from_data(content, acmacs::chart::Verify::None, report_time::no));
+    try {
+        if (auto projections = chart->projections_modify(); projections->size() > 1)
+            projections->keep_just(1); // signature page uses the first projection only
+        std::filesystem::create_directories(dir);
+        file_content::write_replacing(snapshot, acmacs::chart::export_factory(*chart, acmacs::chart::export_format::ace, "sigp", report_time::no));
+        fmt::print("INFO: chart snapshot {} made for {}\n", snapshot, aFilename);
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "WARNING: cannot write chart snapshot {}: {}\n", snapshot, err.what());
+    }
+    return chart;
+
+} // chart_cache::import
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
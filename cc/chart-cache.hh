@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::chart { class Chart; }
+
+namespace chart_cache
+{
+    // directory to keep snapshots of imported charts in, empty (default) disables the cache
+    void setup(std::string_view aCacheDir);
+
+    // imports chart using the snapshot in the cache directory made for the same chart file content,
+    // the snapshot keeps just the first projection and is not compressed.
+    // If there is no snapshot or it cannot be imported, imports aFilename and (re)makes the snapshot.
+    std::shared_ptr<acmacs::chart::Chart> import(std::string_view aFilename);
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
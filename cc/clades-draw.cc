@@ -6,6 +6,7 @@
 #include "tree-draw.hh"
 #include "time-series-draw.hh"
 #include "settings-initializer.hh"
+#include "text-measure.hh"
 
 // ----------------------------------------------------------------------
 
@@ -99,18 +100,20 @@ void CladesDraw::collect()
 {
     if (mClades.empty()) {
           // extract clades from aTree
-        auto scan = [this](const Node& aNode) {
+        std::vector<CladeData*> clade_by_id(mTree.clades.size(), nullptr);
+        std::vector<size_t> inclusion_tolerance(mTree.clades.size(), 0);
+        auto scan = [this, &clade_by_id, &inclusion_tolerance](const Node& aNode) {
             if (aNode.draw.shown) {
-                const auto* node_clades = aNode.data.clades();
-                if (node_clades) {
-                    for (auto& c: *node_clades) {
-                        auto p = mClades.emplace(c, aNode);
-                        if (!p.second) { // the clade is already present, extend its range
-                            const auto for_clade = mSettings.for_clade(c);
-                            // std::cerr << "DEBUG: CladesDraw::collect name \"" << for_clade->name << "\" for clade \"" << c << '"' << '\n';
-                            // std::cerr << "DEBUG: for_clade " << *for_clade << '\n';
-                            // std::cerr << "DEBUG: CladesDraw::collect section_exclusion_tolerance " << for_clade->section_exclusion_tolerance << '\n';
-                            p.first->second.extend(aNode, for_clade->section_inclusion_tolerance);
+                const auto& clade_mask = aNode.data.clade_mask;
+                for (Categories::id_t clade_id = 0; clade_id < clade_mask.size(); ++clade_id) {
+                    if (clade_mask[clade_id]) {
+                        if (auto*& clade = clade_by_id[clade_id]; clade) { // the clade is already present, extend its range
+                            clade->extend(aNode, inclusion_tolerance[clade_id]);
+                        }
+                        else {
+                            const auto name = mTree.clades.name(clade_id);
+                            clade = &mClades.emplace(std::string{name}, aNode).first->second;
+                            inclusion_tolerance[clade_id] = mSettings.for_clade(name)->section_inclusion_tolerance;
                         }
                     }
                 }
@@ -219,7 +222,7 @@ void CladesDraw::draw()
                 // std::cerr << "DEBUG: Clade section " << name_clade.first << '\n' << section_first_node.draw.shown << ' ' << section_first_node.draw.line_no << ' ' << section_first_node.seq_id << '\n' << section_last_node.draw.shown << ' ' << section_last_node.draw.line_no << ' ' << section_last_node.seq_id << '\n';
                 const double top = section_first_node.draw.vertical_pos - mTreeDraw.vertical_step() / 2;
                 const double bottom = section_last_node.draw.vertical_pos + mTreeDraw.vertical_step() / 2;
-                const double label_height = mSurface.text_size("W", Pixels{*for_clade->label_size}, for_clade->label_style).height;
+                const double label_height = measure_text(mSurface, "W", Pixels{*for_clade->label_size}, for_clade->label_style).height;
                 double label_vpos{0};
                 switch (static_cast<CladeDrawSettingsLabelPosition>(for_clade->label_position)) {
                   case CladeDrawSettingsLabelPosition::middle:
@@ -260,7 +263,7 @@ void CladesDraw::draw_left(CladeData::slot_type aSlot, std::string aCladeName, d
     const auto x = mSurface.viewport().size.width - (aSlot + 1) * mSettings.slot_width;
     mSurface.double_arrow({x, top}, {x, bottom}, for_clade.arrow_color, Pixels{*for_clade.line_width}, Pixels{*for_clade.arrow_width});
     std::string name = for_clade.display_name.empty() ? aCladeName : for_clade.display_name;
-    const double label_width = mSurface.text_size(name, Pixels{*for_clade.label_size}, for_clade.label_style).width;
+    const double label_width = measure_text(mSurface, name, Pixels{*for_clade.label_size}, for_clade.label_style).width;
     const acmacs::Offset label_offset{for_clade.label_offset};
     mSurface.text(acmacs::PointCoordinates(x, label_vpos) + acmacs::Offset{- label_offset.x() - label_width, label_offset.y()},
                   name, for_clade.label_color, Pixels{*for_clade.label_size}, for_clade.label_style, Rotation{*for_clade.label_rotation});
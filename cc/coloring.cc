@@ -5,14 +5,48 @@
 #include "coloring.hh"
 #include "tree.hh"
 #include "legend.hh"
+#include "text-measure.hh"
 
 // ----------------------------------------------------------------------
 
-Color ColoringByContinent::color(const Node& aNode) const
+void Coloring::prepare(const Node& aTree)
 {
-    return acmacs::continent_color(aNode.data.continent);
+    mLeafColors.clear();
+    tree::iterate_leaf(aTree, [this](const Node& aLeaf) {
+        if (aLeaf.draw.shown) {
+            if (mLeafColors.size() <= aLeaf.draw.line_no)
+                mLeafColors.resize(aLeaf.draw.line_no + 1, BLACK);
+            mLeafColors[aLeaf.draw.line_no] = leaf_color(aLeaf);
+        }
+    });
+    leaf_colors_done();
+
+} // Coloring::prepare
+
+// ----------------------------------------------------------------------
+
+Color Coloring::color(const Node& aLeaf) const
+{
+    if (aLeaf.draw.line_no >= mLeafColors.size())
+        throw std::runtime_error("Coloring::color: leaf colors were not prepared");
+    return mLeafColors[aLeaf.draw.line_no];
+
+} // Coloring::color
 
-} // ColoringByContinent::color
+// ----------------------------------------------------------------------
+
+Color ColoringByContinent::leaf_color(const Node& aNode)
+{
+    const auto continent_id = aNode.data.continent_id;
+    if (continent_id == Categories::NoId)
+        return acmacs::continent_color(aNode.data.continent);
+    if (mColors.size() <= continent_id)
+        mColors.resize(continent_id + 1);
+    if (!mColors[continent_id])
+        mColors[continent_id] = acmacs::continent_color(aNode.data.continent);
+    return *mColors[continent_id];
+
+} // ColoringByContinent::leaf_color
 
 // ----------------------------------------------------------------------
 
@@ -52,41 +86,70 @@ void ColoringByPos::color_for_aa(const std::map<std::string, std::string>& color
 
 // ----------------------------------------------------------------------
 
-Color ColoringByPos::color(const Node& aNode) const
+std::optional<size_t> ColoringByPos::aa_index(char aa)
+{
+    if (aa >= 'A' && aa <= 'Z')
+        return static_cast<size_t>(aa - 'A');
+    switch (aa) {
+        case '-':
+            return 26;
+        case '*':
+            return 27;
+        case '.':
+            return 28;
+        case '~':
+            return 29;
+        case '?':
+            return 30;
+        default:
+            return std::nullopt;
+    }
+
+} // ColoringByPos::aa_index
+
+// ----------------------------------------------------------------------
+
+Color ColoringByPos::leaf_color(const Node& aNode)
 {
-    Color c("pink");
     const auto amino_acids = aNode.data.amino_acids();
-    if (amino_acids.size() > mPos) {
-        const char aa = amino_acids[mPos];
+    if (amino_acids.size() <= mPos)
+        return Color("pink");
+
+    const char aa = amino_acids[mPos];
+    const auto index = aa_index(aa);
+    auto& aa_color = index ? mAAColors[*index] : mOtherAAColors[aa];
+    if (aa_color.aa == 0) {
+        aa_color.aa = aa;
         if (!colors_.empty()) {
-            try {
-                c = colors_.at(std::string(1, aa));
-                if (auto found = mUsed.find(aa); found == mUsed.end())
-                    mUsed[aa] = std::make_pair(c, 1);
-                else
-                    ++found->second.second;
-            }
-            catch (std::out_of_range&) {
+            if (const auto found = colors_.find(std::string(1, aa)); found != colors_.end())
+                aa_color.color = Color(found->second);
+            else
                 throw std::runtime_error(std::string{"\"color_for_aa\" in settings does not provide color for "} + aa);
-            }
-        }
-        else {
-            auto distinct_colors = acmacs::color::distinct();
-            try {
-                auto& cc = mUsed.at(aa);
-                ++cc.second;
-                c = cc.first;
-            }
-            catch (std::out_of_range&) {
-                if (aa != 'X') // X is always black
-                    c = distinct_colors[mUsed.size()];
-                mUsed[aa] = std::make_pair(c, 1);
-            }
         }
+        else if (aa != 'X') // X is always pink
+            aa_color.color = acmacs::color::distinct()[mNumberUsed];
+        else
+            aa_color.color = Color("pink");
+        ++mNumberUsed;
+    }
+    ++aa_color.count;
+    return aa_color.color;
+
+} // ColoringByPos::leaf_color
+
+// ----------------------------------------------------------------------
+
+void ColoringByPos::leaf_colors_done()
+{
+    mUsed.clear();
+    for (const auto& aa_color : mAAColors) {
+        if (aa_color.aa != 0)
+            mUsed[aa_color.aa] = std::make_pair(aa_color.color, aa_color.count);
     }
-    return c;
+    for (const auto& [aa, aa_color] : mOtherAAColors)
+        mUsed[aa] = std::make_pair(aa_color.color, aa_color.count);
 
-} // ColoringByPos::color
+} // ColoringByPos::leaf_colors_done
 
 // ----------------------------------------------------------------------
 
@@ -110,16 +173,16 @@ class ColoringByPosLegend : public Legend
     void draw(acmacs::surface::Surface& aSurface, const LegendSettings& aSettings) const override
         {
               // aSurface.border(0xA0FFA000, 1);
-            const auto title_size = aSurface.text_size(mTitle, Pixels{*aSettings.title_size}, aSettings.title_style);
+            const auto title_size = measure_text(aSurface, mTitle, Pixels{*aSettings.title_size}, aSettings.title_style);
             acmacs::PointCoordinates origin(0, title_size.height);
-              //origin += Size((aSurface.text_size(mTitle, mFontSize, mStyle).width - label_size.width) / 2, label_size.height * mInterline);
-            const auto text_size = aSurface.text_size("W", Pixels{*aSettings.text_size}, aSettings.text_style);
+              //origin += Size((measure_text(aSurface, mTitle, mFontSize, mStyle).width - label_size.width) / 2, label_size.height * mInterline);
+            const auto text_size = measure_text(aSurface, "W", Pixels{*aSettings.text_size}, aSettings.text_style);
             double max_width = 0;
             for (auto& label_color: mColoring.used_colors()) {
                 origin.y(origin.y() + text_size.height * aSettings.interline);
                 const std::string text = std::string(1, label_color.first) + " (" + std::to_string(label_color.second.second) + ")";
                 aSurface.text(origin, text, label_color.second.first, Pixels{*aSettings.text_size}, aSettings.text_style);
-                max_width = std::max(max_width, aSurface.text_size(text, Pixels{*aSettings.text_size}, aSettings.text_style).width);
+                max_width = std::max(max_width, measure_text(aSurface, text, Pixels{*aSettings.text_size}, aSettings.text_style).width);
             }
             aSurface.text({(max_width - title_size.width) / 2, title_size.height}, mTitle, BLACK, Pixels{*aSettings.title_size}, aSettings.title_style);
         }
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <map>
+#include <array>
+#include <vector>
+#include <optional>
+#include <algorithm>
 
 #include "acmacs-base/color.hh"
 
@@ -12,22 +16,35 @@ class SettingsLegend;
 
 // ----------------------------------------------------------------------
 
+// Leaf colors are computed once per render by prepare() and stored in a dense array indexed by leaf line_no,
+// color() is then a plain lookup that does not modify coloring and can be called from several threads.
 class Coloring
 {
  public:
     virtual ~Coloring() = default;
-    virtual Color color(const Node&) const = 0;
+    void prepare(const Node& aTree); // after TreeDraw::set_line_no()
+    Color color(const Node& aLeaf) const;
     virtual Legend* legend() const = 0;
     virtual void report() const {}
-};
+
+ protected:
+    virtual Color leaf_color(const Node& aLeaf) = 0; // called by prepare() for each shown leaf in the drawing order
+    virtual void leaf_colors_done() {}
+
+ private:
+    std::vector<Color> mLeafColors; // indexed by line_no
+
+}; // class Coloring
 
 // ----------------------------------------------------------------------
 
 class ColoringBlack : public Coloring
 {
  public:
-    Color color(const Node&) const override { return 0; }
     Legend* legend() const override { return nullptr; }
+
+ protected:
+    Color leaf_color(const Node&) override { return 0; }
 };
 
 // ----------------------------------------------------------------------
@@ -35,9 +52,14 @@ class ColoringBlack : public Coloring
 class ColoringByContinent : public Coloring
 {
  public:
-    Color color(const Node& aNode) const override;
     Legend* legend() const override;
 
+ protected:
+    Color leaf_color(const Node& aNode) override;
+
+ private:
+    std::vector<std::optional<Color>> mColors; // indexed by continent_id
+
 }; // class ColoringByContinent
 
 
@@ -50,7 +72,6 @@ class ColoringByPos : public Coloring
 
     ColoringByPos(size_t aPos) : mPos(aPos - 1) {}
 
-    Color color(const Node& aNode) const override;
     Legend* legend() const override;
     size_t pos() const { return mPos; }
     const UsedColors& used_colors() const { return mUsed; }
@@ -58,12 +79,58 @@ class ColoringByPos : public Coloring
 
     void report() const override;
 
+ protected:
+    Color leaf_color(const Node& aNode) override;
+    void leaf_colors_done() override;
+
  private:
+    struct AAColor
+    {
+        char aa = 0;            // 0 - not yet used
+        Color color = BLACK;
+        size_t count = 0;
+    };
+
     size_t mPos;
-    mutable UsedColors mUsed;
+    UsedColors mUsed;
     std::map<std::string, std::string> colors_;
+    std::array<AAColor, 31> mAAColors; // indexed by aa_index(), filled and counted by leaf_color()
+    std::map<char, AAColor> mOtherAAColors; // characters aa_index() has no slot for, each gets its own color
+    size_t mNumberUsed = 0;
+
+    static std::optional<size_t> aa_index(char aa); // nullopt if aa is not in the table
 };
 
+// ----------------------------------------------------------------------
+
+// Most frequent color among the leaves of a subtree collapsed into a wedge
+class ColorCounter
+{
+ public:
+    void add(Color aColor)
+    {
+        if (auto found = std::find_if(mColors.begin(), mColors.end(), [aColor](const auto& entry) { return entry.first == aColor; }); found != mColors.end())
+            ++found->second;
+        else
+            mColors.emplace_back(aColor, 1);
+        ++mCount;
+    }
+
+    Color dominant() const
+    {
+        if (mColors.empty())
+            return 0;
+        return std::max_element(mColors.begin(), mColors.end(), [](const auto& e1, const auto& e2) { return e1.second < e2.second; })->first;
+    }
+
+    size_t count() const { return mCount; }
+
+ private:
+    std::vector<std::pair<Color, size_t>> mColors;
+    size_t mCount = 0;
+
+}; // class ColorCounter
+
 // ----------------------------------------------------------------------
 /// Local Variables:
 /// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
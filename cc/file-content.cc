@@ -0,0 +1,73 @@
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <thread>
+#include <unistd.h>
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-base/read-file.hh"
+#include "signature-page/file-content.hh"
+
+// ----------------------------------------------------------------------
+
+std::string file_content::read_raw(std::string_view aFilename)
+{
+    std::ifstream file{std::string{aFilename}, std::ios::binary};
+    if (!file)
+        throw std::runtime_error(fmt::format("cannot read {}", aFilename));
+    return {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+} // file_content::read_raw
+
+// ----------------------------------------------------------------------
+
+std::uint64_t file_content::hash(std::string_view aContent)
+{
+    std::uint64_t result{0xcbf29ce484222325ULL};
+    for (const auto ch : aContent) {
+        result ^= static_cast<unsigned char>(ch);
+        result *= 0x100000001b3ULL;
+    }
+    return result;
+
+} // file_content::hash
+
+// ----------------------------------------------------------------------
+
+std::string file_content::stamp(std::string_view aFilename)
+{
+    const auto content = read_raw(aFilename);
+    return fmt::format("{} {:016x}", content.size(), hash(content));
+
+} // file_content::stamp
+
+// ----------------------------------------------------------------------
+
+void file_content::write_replacing(std::string_view aFilename, const std::function<void(std::string_view aTempFilename)>& aWriter)
+{
+    const std::filesystem::path target{aFilename};
+    const auto temp = target.parent_path() / fmt::format(".{}-{:x}.{}", getpid(), std::hash<std::thread::id>{}(std::this_thread::get_id()), target.filename().string());
+    try {
+        aWriter(temp.string());
+        std::filesystem::rename(temp, target); // atomic within the same file system
+    }
+    catch (std::exception&) {
+        std::error_code ec;
+        std::filesystem::remove(temp, ec);
+        throw;
+    }
+
+} // file_content::write_replacing
+
+// ----------------------------------------------------------------------
+
+void file_content::write_replacing(std::string_view aFilename, std::string_view aContent)
+{
+    write_replacing(aFilename, [aContent](std::string_view aTempFilename) { acmacs::file::write(aTempFilename, aContent); });
+
+} // file_content::write_replacing
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <functional>
+
+// ----------------------------------------------------------------------
+
+namespace file_content
+{
+    // file content as is, compressed files (.xz, .bz2) are not decompressed, throws std::runtime_error if file cannot be read
+    std::string read_raw(std::string_view aFilename);
+
+    // 64-bit FNV-1a hash of aContent, unlike std::hash it does not depend on the standard library implementation,
+    // i.e. hashes stored in files by one build are valid for another one
+    std::uint64_t hash(std::string_view aContent);
+
+    // "<size> <hash>" of the raw file content, used to detect that a file stored next to (or made for) a chart is outdated
+    std::string stamp(std::string_view aFilename);
+
+    // aWriter writes to a temporary file in the same directory, then it is renamed to aFilename,
+    // i.e. other processes (e.g. sigp --batch jobs) never read a partially written file.
+    // The temporary file name ends with the name of aFilename, i.e. it is compressed by the writer the same way (.xz).
+    void write_replacing(std::string_view aFilename, const std::function<void(std::string_view aTempFilename)>& aWriter);
+    void write_replacing(std::string_view aFilename, std::string_view aContent);
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
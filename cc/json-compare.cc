@@ -0,0 +1,162 @@
+#include <cmath>
+#include <algorithm>
+
+#include "acmacs-base/fmt.hh"
+#include "signature-page/json-compare.hh"
+
+// ----------------------------------------------------------------------
+
+namespace json_compare
+{
+    class Comparator
+    {
+     public:
+        Comparator(const Options& aOptions) : mOptions(aOptions) {}
+
+        void compare(const rjson::value& expected, const rjson::value& actual, const std::string& path);
+        const std::vector<std::string>& differences() const { return mDifferences; }
+
+     private:
+        const Options& mOptions;
+        std::vector<std::string> mDifferences;
+
+        using members_t = std::vector<std::pair<std::string_view, const rjson::value*>>;
+
+        void compare_objects(const rjson::value& expected, const rjson::value& actual, const std::string& path);
+        void compare_arrays(const rjson::value& expected, const rjson::value& actual, const std::string& path);
+        members_t members(const rjson::value& object) const;
+        void difference(const std::string& path, std::string_view message) { mDifferences.push_back(fmt::format("{}: {}", path.empty() ? std::string{"."} : path, message)); }
+    };
+
+    static std::string_view type_name(const rjson::value& value);
+    inline std::string member_path(const std::string& path, std::string_view key) { return path.empty() ? std::string{key} : fmt::format("{}.{}", path, key); }
+
+} // namespace json_compare
+
+// ----------------------------------------------------------------------
+
+std::vector<std::string> json_compare::compare(const rjson::value& expected, const rjson::value& actual, const Options& options)
+{
+    Comparator comparator(options);
+    comparator.compare(expected, actual, std::string{});
+    return comparator.differences();
+
+} // json_compare::compare
+
+// ----------------------------------------------------------------------
+
+std::vector<std::string> json_compare::compare_files(std::string_view expected, std::string_view actual, const Options& options)
+{
+    return compare(rjson::parse_file(expected), rjson::parse_file(actual), options);
+
+} // json_compare::compare_files
+
+// ----------------------------------------------------------------------
+
+void json_compare::Comparator::compare(const rjson::value& expected, const rjson::value& actual, const std::string& path)
+{
+    if (expected.is_object() && actual.is_object())
+        compare_objects(expected, actual, path);
+    else if (expected.is_array() && actual.is_array())
+        compare_arrays(expected, actual, path);
+    else if (expected.is_number() && actual.is_number()) {
+        const auto expected_number = expected.to<double>(), actual_number = actual.to<double>();
+        if (std::abs(expected_number - actual_number) > mOptions.number_tolerance * std::max({1.0, std::abs(expected_number), std::abs(actual_number)}))
+            difference(path, fmt::format("{} vs. {}", rjson::format(expected), rjson::format(actual)));
+    }
+    else if (expected.is_string() && actual.is_string()) {
+        if (expected.to<std::string_view>() != actual.to<std::string_view>())
+            difference(path, fmt::format("{} vs. {}", rjson::format(expected), rjson::format(actual)));
+    }
+    else if (expected.is_bool() && actual.is_bool()) {
+        if (expected.to<bool>() != actual.to<bool>())
+            difference(path, fmt::format("{} vs. {}", rjson::format(expected), rjson::format(actual)));
+    }
+    else if (!expected.is_null() || !actual.is_null())
+        difference(path, fmt::format("{} vs. {}", type_name(expected), type_name(actual)));
+
+} // json_compare::Comparator::compare
+
+// ----------------------------------------------------------------------
+
+json_compare::Comparator::members_t json_compare::Comparator::members(const rjson::value& object) const
+{
+    members_t result;
+    rjson::for_each(object, [&result, this](std::string_view key, const rjson::value& item) {
+        if (mOptions.ignore_keys.find(key) == mOptions.ignore_keys.end())
+            result.emplace_back(key, &item);
+    });
+    return result;
+
+} // json_compare::Comparator::members
+
+// ----------------------------------------------------------------------
+
+void json_compare::Comparator::compare_objects(const rjson::value& expected, const rjson::value& actual, const std::string& path)
+{
+    auto expected_members = members(expected), actual_members = members(actual);
+
+    if (mOptions.object_key_order && expected_members.size() == actual_members.size() &&
+        !std::equal(expected_members.begin(), expected_members.end(), actual_members.begin(), [](const auto& e1, const auto& e2) { return e1.first == e2.first; }))
+        difference(path, "different key order");
+
+    const auto by_key = [](const auto& e1, const auto& e2) { return e1.first < e2.first; };
+    std::sort(expected_members.begin(), expected_members.end(), by_key);
+    std::sort(actual_members.begin(), actual_members.end(), by_key);
+    auto expected_member = expected_members.begin();
+    auto actual_member = actual_members.begin();
+    while (expected_member != expected_members.end() || actual_member != actual_members.end()) {
+        if (actual_member == actual_members.end() || (expected_member != expected_members.end() && expected_member->first < actual_member->first)) {
+            difference(member_path(path, expected_member->first), "missing");
+            ++expected_member;
+        }
+        else if (expected_member == expected_members.end() || actual_member->first < expected_member->first) {
+            difference(member_path(path, actual_member->first), "unexpected");
+            ++actual_member;
+        }
+        else {
+            compare(*expected_member->second, *actual_member->second, member_path(path, expected_member->first));
+            ++expected_member;
+            ++actual_member;
+        }
+    }
+
+} // json_compare::Comparator::compare_objects
+
+// ----------------------------------------------------------------------
+
+void json_compare::Comparator::compare_arrays(const rjson::value& expected, const rjson::value& actual, const std::string& path)
+{
+    const auto common = std::min(expected.size(), actual.size());
+    for (size_t index = 0; index < common; ++index)
+        compare(expected[index], actual[index], fmt::format("{}[{}]", path, index));
+    if (expected.size() != actual.size())
+        difference(path, fmt::format("{} elements vs. {}", expected.size(), actual.size()));
+
+} // json_compare::Comparator::compare_arrays
+
+// ----------------------------------------------------------------------
+
+std::string_view json_compare::type_name(const rjson::value& value)
+{
+    if (value.is_object())
+        return "object";
+    else if (value.is_array())
+        return "array";
+    else if (value.is_string())
+        return "string";
+    else if (value.is_number())
+        return "number";
+    else if (value.is_bool())
+        return "bool";
+    else if (value.is_null())
+        return "null";
+    else
+        return "unknown";
+
+} // json_compare::type_name
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
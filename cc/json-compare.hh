@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+
+#include "acmacs-base/rjson.hh"
+
+// ----------------------------------------------------------------------
+
+namespace json_compare
+{
+    struct Options
+    {
+        double number_tolerance = 1e-10;  // numbers are equal if they differ by no more than number_tolerance * max(1, |number|)
+        bool object_key_order = false;    // objects with the same keys in different order differ
+        std::set<std::string, std::less<>> ignore_keys; // object keys not compared at any level, e.g. " timestamp"
+    };
+
+    // Structural comparison of json values, formatting is irrelevant.
+    // Returns differences, each prefixed with the json path, e.g. "tree.mods[2].d1: 0.04 vs. 0.05", empty if values are equal.
+    std::vector<std::string> compare(const rjson::value& expected, const rjson::value& actual, const Options& options = Options{});
+    std::vector<std::string> compare_files(std::string_view expected, std::string_view actual, const Options& options = Options{});
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
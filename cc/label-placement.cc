@@ -0,0 +1,103 @@
+#include <cmath>
+#include <tuple>
+
+#include "signature-page/label-placement.hh"
+
+// ----------------------------------------------------------------------
+
+LabelPlacement::LabelPlacement(const acmacs::Size& aArea, double aCellSize)
+    : mCellSize(aCellSize > 0.0 ? aCellSize : 1.0),
+      mColumns(static_cast<size_t>(std::ceil(aArea.width / mCellSize)) + 1),
+      mRows(static_cast<size_t>(std::ceil(aArea.height / mCellSize)) + 1),
+      mCells(mColumns * mRows)
+{
+
+} // LabelPlacement::LabelPlacement
+
+// ----------------------------------------------------------------------
+
+size_t LabelPlacement::column(double x) const
+{
+    return std::min(static_cast<size_t>(std::max(x / mCellSize, 0.0)), mColumns - 1);
+
+} // LabelPlacement::column
+
+// ----------------------------------------------------------------------
+
+size_t LabelPlacement::row(double y) const
+{
+    return std::min(static_cast<size_t>(std::max(y / mCellSize, 0.0)), mRows - 1);
+
+} // LabelPlacement::row
+
+// ----------------------------------------------------------------------
+
+void LabelPlacement::add(const Box& aBox, Obstacle aObstacle)
+{
+    const auto box_no = mBoxes.size();
+    mBoxes.push_back(aBox);
+    mObstacles.push_back(aObstacle);
+    for (auto row_no = row(aBox.top); row_no <= row(aBox.bottom); ++row_no) {
+        for (auto column_no = column(aBox.left); column_no <= column(aBox.right); ++column_no)
+            mCells[row_no * mColumns + column_no].push_back(box_no);
+    }
+
+} // LabelPlacement::add
+
+// ----------------------------------------------------------------------
+
+bool LabelPlacement::collides(const Box& aBox, Obstacle aObstacle) const
+{
+    for (auto row_no = row(aBox.top); row_no <= row(aBox.bottom); ++row_no) {
+        for (auto column_no = column(aBox.left); column_no <= column(aBox.right); ++column_no) {
+            for (auto box_no : mCells[row_no * mColumns + column_no]) {
+                if ((aObstacle == Obstacle::Soft || mObstacles[box_no] == Obstacle::Hard) && mBoxes[box_no].intersects(aBox))
+                    return true;
+            }
+        }
+    }
+    return false;
+
+} // LabelPlacement::collides
+
+// ----------------------------------------------------------------------
+
+acmacs::Offset LabelPlacement::place(const Box& aBox, double aRange, double aStep)
+{
+    std::vector<std::tuple<double, double, double>> candidates; // distance^2, y, x
+    if (aStep > 0.0) {
+        const auto steps = static_cast<int>(std::floor(aRange / aStep));
+        for (int y_step = -steps; y_step <= steps; ++y_step) {
+            for (int x_step = -steps; x_step <= steps; ++x_step) {
+                const double x = x_step * aStep, y = y_step * aStep;
+                if ((x * x + y * y) <= (aRange * aRange))
+                    candidates.emplace_back(x * x + y * y, y, x);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+    }
+    else
+        candidates.emplace_back(0.0, 0.0, 0.0);
+
+    const auto find_candidate = [&](Obstacle aObstacle) -> const std::tuple<double, double, double>* {
+        for (const auto& candidate : candidates) {
+            if (!collides(aBox.shifted({std::get<2>(candidate), std::get<1>(candidate)}), aObstacle))
+                return &candidate;
+        }
+        return nullptr;
+    };
+
+    acmacs::Offset offset{0.0, 0.0};
+    if (const auto* candidate = find_candidate(Obstacle::Soft); candidate)
+        offset = acmacs::Offset{std::get<2>(*candidate), std::get<1>(*candidate)};
+    else if (candidate = find_candidate(Obstacle::Hard); candidate)
+        offset = acmacs::Offset{std::get<2>(*candidate), std::get<1>(*candidate)};
+    add(aBox.shifted(offset), Obstacle::Hard);
+    return offset;
+
+} // LabelPlacement::place
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
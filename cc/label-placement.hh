@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "acmacs-draw/surface.hh"
+
+// ----------------------------------------------------------------------
+
+// Placement of labels avoiding overlaps with already placed labels (hard obstacles)
+// and with other elements, e.g. tree edges (soft obstacles).
+// Boxes are kept in a uniform grid, a collision query looks only at the boxes registered in the cells covered by the queried box.
+// Candidate offsets are tried in a fixed order, placement does not depend on anything but the drawing geometry.
+class LabelPlacement
+{
+ public:
+    struct Box
+    {
+        double left, top, right, bottom;
+
+        Box shifted(const acmacs::Offset& aOffset) const { return {left + aOffset.x(), top + aOffset.y(), right + aOffset.x(), bottom + aOffset.y()}; }
+        bool intersects(const Box& aBox) const { return left < aBox.right && aBox.left < right && top < aBox.bottom && aBox.top < bottom; }
+    };
+
+    enum class Obstacle { Soft, Hard };
+
+    LabelPlacement(const acmacs::Size& aArea, double aCellSize);
+
+    void add(const Box& aBox, Obstacle aObstacle);
+    void add_line(const acmacs::PointCoordinates& a, const acmacs::PointCoordinates& b, double aWidth) // soft obstacle
+    {
+        add({std::min(a.x(), b.x()) - aWidth / 2, std::min(a.y(), b.y()) - aWidth / 2, std::max(a.x(), b.x()) + aWidth / 2, std::max(a.y(), b.y()) + aWidth / 2}, Obstacle::Soft);
+    }
+
+      // Returns offset for aBox: the first candidate not colliding with anything, otherwise the first candidate not colliding with hard obstacles,
+      // otherwise zero offset. Candidates are within aRange with aStep between them, ordered by distance, then by y, then by x.
+      // Placed box is added as a hard obstacle.
+    acmacs::Offset place(const Box& aBox, double aRange, double aStep);
+
+ private:
+    double mCellSize;
+    size_t mColumns, mRows;
+    std::vector<Box> mBoxes;
+    std::vector<Obstacle> mObstacles;
+    std::vector<std::vector<size_t>> mCells; // box indexes per cell
+
+    size_t column(double x) const;
+    size_t row(double y) const;
+    bool collides(const Box& aBox, Obstacle aObstacle) const; // with obstacles of aObstacle kind or harder
+
+}; // class LabelPlacement
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
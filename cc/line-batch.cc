@@ -0,0 +1,61 @@
+#include <limits>
+#include <algorithm>
+
+#include "acmacs-base/fmt.hh"
+#include "signature-page/line-batch.hh"
+
+// ----------------------------------------------------------------------
+
+size_t LineBatch::sSegments = 0;
+size_t LineBatch::sStrokes = 0;
+
+// ----------------------------------------------------------------------
+
+void LineBatch::line(const acmacs::PointCoordinates& a, const acmacs::PointCoordinates& b, Color aColor, Pixels aWidth, acmacs::surface::LineCap aLineCap)
+{
+    ++sSegments;
+    if (a.x() < 0 || b.x() < 0) { // negative x cannot be passed to path_outline_negative_move
+        flush();                  // segments added before are drawn below this one
+        mSurface.line(a, b, aColor, aWidth, aLineCap);
+        ++sStrokes;
+        return;
+    }
+
+    auto group = std::find_if(mGroups.begin(), mGroups.end(), [&](const Group& gr) { return gr.color == aColor && gr.width.value() == aWidth.value() && gr.line_cap == aLineCap; });
+    if (group == mGroups.end())
+        group = mGroups.insert(mGroups.end(), Group{aColor, aWidth, aLineCap, {}});
+    if (a.x() != group->last_x || a.y() != group->last_y) { // new sub-path unless segment continues the previous one
+        group->path.push_back(a.x() > 0 ? -a.x() : -std::numeric_limits<double>::min());
+        group->path.push_back(a.y());
+    }
+    group->path.push_back(b.x());
+    group->path.push_back(b.y());
+    group->last_x = b.x();
+    group->last_y = b.y();
+
+} // LineBatch::line
+
+// ----------------------------------------------------------------------
+
+void LineBatch::flush()
+{
+    for (const auto& group : mGroups) {
+        mSurface.path_outline_negative_move(group.path.data(), group.path.data() + group.path.size(), group.color, group.width, false, group.line_cap);
+        ++sStrokes;
+    }
+    mGroups.clear();
+
+} // LineBatch::flush
+
+// ----------------------------------------------------------------------
+
+void LineBatch::report()
+{
+    fmt::print("INFO: line segments: {} strokes: {}\n", sSegments, sStrokes);
+
+} // LineBatch::report
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include "acmacs-draw/surface.hh"
+
+// ----------------------------------------------------------------------
+
+// Collects line segments and draws all segments of the same color, width and line cap as one path with a single stroke.
+// Groups are drawn in the order of their first segment, segments within a group keep their order,
+// i.e. z-order is kept between groups but not between segments of different groups added in turns.
+// A segment with negative x is drawn on its own, groups collected before it are flushed first.
+// Otherwise nothing is drawn until flush().
+class LineBatch
+{
+ public:
+    LineBatch(acmacs::surface::Surface& aSurface) : mSurface(aSurface) {}
+
+    void line(const acmacs::PointCoordinates& a, const acmacs::PointCoordinates& b, Color aColor, Pixels aWidth, acmacs::surface::LineCap aLineCap = acmacs::surface::LineCap::Butt);
+    void line(const acmacs::PointCoordinates& a, const acmacs::PointCoordinates& b, Color aColor, Scaled aWidth, acmacs::surface::LineCap aLineCap = acmacs::surface::LineCap::Butt)
+    {
+        line(a, b, aColor, Pixels{aWidth.value() / mSurface.convert(Pixels{1}).value()}, aLineCap);
+    }
+    void flush();
+
+    static void report();
+
+ private:
+    struct Group
+    {
+        Color color;
+        Pixels width;
+        acmacs::surface::LineCap line_cap;
+        std::vector<double> path; // x, y pairs, negative x starts new sub-path, see Surface::path_outline_negative_move()
+        double last_x = -1, last_y = -1;
+    };
+
+    acmacs::surface::Surface& mSurface;
+    std::vector<Group> mGroups;
+
+    static size_t sSegments, sStrokes;
+
+}; // class LineBatch
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -1,5 +1,7 @@
 // Converts tree.json to data.csv and tree.newick for https://github.com/acorg/isig
 
+#include <cstdlib>
+
 #include "acmacs-base/data-formatter.hh"
 #include "acmacs-base/read-file.hh"
 #include "acmacs-base/enumerate.hh"
@@ -8,6 +10,7 @@
 #include "acmacs-chart-2/factory-import.hh"
 #include "signature-page/tree.hh"
 #include "signature-page/tree-export.hh"
+#include "signature-page/chart-cache.hh"
 
 // ----------------------------------------------------------------------
 
@@ -22,11 +25,13 @@ int main(int argc, const char* const* argv)
         std::string target_csv = argv[3];
         std::string target_tree_file = argv[4];
 
+        if (const char* chart_cache_dir = std::getenv("SIGP_CHART_CACHE"); chart_cache_dir)
+            chart_cache::setup(chart_cache_dir);
         const auto& seqdb = acmacs::seqdb::get();
         Tree tree = tree::tree_import(source_tree_file);
           // tree.match_seqdb(seqdb);
 
-        auto chart = acmacs::chart::import_from_file(source_chart); // , acmacs::chart::Verify::None, report_time::no
+        auto chart = chart_cache::import(source_chart); // , acmacs::chart::Verify::None, report_time::no
         auto antigens = chart->antigens();
         const auto per_antigen = seqdb.match(*antigens, chart->info()->virus_type());
 
@@ -73,7 +78,8 @@ int main(int argc, const char* const* argv)
         tree::export_to_newick(target_tree_file, tree, 2);
     }
     else {
-        std::cerr << "Usage: " << argv[0] << " tree.json[.xz] chart.ace data.csv tree.newick\n";
+        std::cerr << "Usage: " << argv[0] << " tree.json[.xz] chart.ace data.csv tree.newick\n"
+                  << "  SIGP_CHART_CACHE env var: directory to keep uncompressed snapshots of charts in\n";
         exit_code = 1;
     }
     return exit_code;
@@ -1,3 +1,5 @@
+#include <map>
+
 #include "acmacs-base/log.hh"
 #include "acmacs-base/timeit.hh"
 
@@ -58,21 +60,39 @@ void MappedAntigensDraw::prepare()
 
 // ----------------------------------------------------------------------
 
-void MappedAntigensDraw::draw()
+void MappedAntigensDraw::prepare_draw()
 {
-      // mSurface.border("brown", 1);
-
     const double surface_width = mSurface.viewport().size.width;
     const double line_length = surface_width * mSettings.line_length;
     const double base_x = (surface_width - line_length) / 2;
 
+    std::map<const Node*, size_t> collapsed; // leaves of subtrees collapsed into wedges: wedge -> number of mapped leaves
     auto draw_dash = [&](const Node& aNode) {
         if (aNode.draw.shown && aNode.draw.chart_antigen_index) {
-            mSurface.line({base_x, aNode.draw.vertical_pos}, {base_x + line_length, aNode.draw.vertical_pos}, mSettings.line_color, Pixels{*mSettings.line_width}, acmacs::surface::LineCap::Round);
+            if (aNode.draw.collapsed_into)
+                ++collapsed[aNode.draw.collapsed_into];
+            else
+                mLines.line({base_x, aNode.draw.vertical_pos}, {base_x + line_length, aNode.draw.vertical_pos}, mSettings.line_color, Pixels{*mSettings.line_width}, acmacs::surface::LineCap::Round);
         }
     };
     tree::iterate_leaf(mTree, draw_dash);
 
+      // one line per wedge, line gets thicker with the number of mapped leaves up to the wedge height
+    const double line_width = mSurface.convert(Pixels{*mSettings.line_width}).value();
+    for (const auto& [wedge, mapped] : collapsed) {
+        const double wedge_height = wedge->draw.collapsed->bottom - wedge->draw.collapsed->top;
+        mLines.line({base_x, wedge->draw.vertical_pos}, {base_x + line_length, wedge->draw.vertical_pos}, mSettings.line_color, Scaled{std::min(line_width * static_cast<double>(mapped), std::max(wedge_height, line_width))});
+    }
+
+} // MappedAntigensDraw::prepare_draw
+
+// ----------------------------------------------------------------------
+
+void MappedAntigensDraw::draw()
+{
+      // mSurface.border("brown", 1);
+    mLines.flush();
+
 } // MappedAntigensDraw::draw
 
 // ----------------------------------------------------------------------
@@ -4,6 +4,7 @@
 
 #include "acmacs-base/settings-v1.hh"
 #include "acmacs-draw/surface.hh"
+#include "line-batch.hh"
 
 // ----------------------------------------------------------------------
 
@@ -31,9 +32,10 @@ class MappedAntigensDraw
 {
  public:
     MappedAntigensDraw(acmacs::surface::Surface& aSurface, Tree& aTree, /* const TreeDraw& aTreeDraw, */ const ChartDrawBase& aChart, MappedAntigensDrawSettings& aSettings)
-        : mSurface(aSurface), mTree(aTree), /* mTreeDraw(aTreeDraw), */ mChart(aChart), mSettings(aSettings) {}
+        : mSurface(aSurface), mTree(aTree), /* mTreeDraw(aTreeDraw), */ mChart(aChart), mSettings(aSettings), mLines(aSurface) {}
 
     void prepare();
+    void prepare_draw();
     void draw();
 
     acmacs::surface::Surface& surface() { return mSurface; }
@@ -44,6 +46,7 @@ class MappedAntigensDraw
     // const TreeDraw& mTreeDraw;
     const ChartDrawBase& mChart;
     MappedAntigensDrawSettings& mSettings;
+    LineBatch mLines;           // collected by prepare_draw()
 
 }; // class MappedAntigensDraw
 
@@ -1,11 +1,16 @@
 #include <cmath>
+#include <array>
+#include <algorithm>
+#include <functional>
 
 #include "acmacs-base/log.hh"
+#include "acmacs-base/fmt.hh"
 #include "acmacs-base/float.hh"
 #include "acmacs-base/read-file.hh"
 #include "acmacs-base/date.hh"
 
 #include "settings.hh"
+#include "json-compare.hh"
 using namespace std::string_literals;
 
 // ----------------------------------------------------------------------
@@ -120,6 +125,225 @@ void write_settings(const Settings& aSettings, std::string_view aFilename)
 
 } // write_settings
 
+// ----------------------------------------------------------------------
+
+using SettingsErrors = std::vector<std::string>;
+
+template <typename Read> static void check_value(SettingsErrors& errors, std::string_view path, Read&& read)
+{
+    try {
+        read();
+    }
+    catch (std::exception& err) {
+        errors.push_back(fmt::format("{}: {}", path, err.what()));
+    }
+}
+
+static void check_color(SettingsErrors& errors, std::string_view path, const acmacs::settings::v1::field<Color>& field)
+{
+    if (field.is_set())
+        check_value(errors, path, [&field]() { [[maybe_unused]] const Color color = *field; });
+}
+
+// parameters of a mod, mod path is e.g. "tree.mods[2]"
+template <typename Mod> class ModParameters
+{
+ public:
+    ModParameters(const Mod& aMod, std::string aPath, SettingsErrors& aErrors) : mMod(aMod), mPath(aPath), mErrors(aErrors) {}
+
+    void text(std::string_view key, const acmacs::settings::v1::field<std::string> Mod::*field)
+    {
+        if (required(key, field))
+            check_value(mErrors, path(key), [this, field]() { [[maybe_unused]] const std::string value = *(mMod.*field); });
+    }
+
+    void number(std::string_view key, const acmacs::settings::v1::field<double> Mod::*field)
+    {
+        if (required(key, field))
+            check_value(mErrors, path(key), [this, field]() { [[maybe_unused]] const double value = *(mMod.*field); });
+    }
+
+    void color(std::string_view key, const acmacs::settings::v1::field<std::string> Mod::*field, bool aRequired = true)
+    {
+        if (aRequired ? required(key, field) : (mMod.*field).is_set())
+            check_value(mErrors, path(key), [this, field]() { [[maybe_unused]] const Color value{*(mMod.*field)}; });
+    }
+
+    void error(std::string_view key, std::string_view message) { mErrors.push_back(fmt::format("{}: {}", path(key), message)); }
+    std::string path(std::string_view key) const { return fmt::format("{}.{}", mPath, key); }
+    const Mod& mod() const { return mMod; }
+
+ private:
+    const Mod& mMod;
+    const std::string mPath;
+    SettingsErrors& mErrors;
+
+    template <typename Field> bool required(std::string_view key, const Field Mod::*field)
+    {
+        if ((mMod.*field).is_set_or_has_default())
+            return true;
+        error(key, "required by mod");
+        return false;
+    }
+};
+
+// ----------------------------------------------------------------------
+
+static void validate_tree_mods(const Settings& aSettings, SettingsErrors& errors)
+{
+    using Parameters = ModParameters<TreeDrawMod>;
+    const auto line = [](Parameters& param, std::string_view key, const acmacs::settings::v1::field<std::string> TreeDrawMod::*field) {
+        param.text(key, field);
+        param.color("color", &TreeDrawMod::color);
+        param.number("line_width", &TreeDrawMod::line_width);
+    };
+
+    const std::map<std::string, std::function<void(Parameters&)>, std::less<>> schema{ // see TreeDraw::apply_mods()
+        {"root", [](Parameters& param) { param.text("s1", &TreeDrawMod::s1); }},
+        {"hide-isolated-before", [](Parameters& param) { param.text("s1", &TreeDrawMod::s1); }},
+        {"hide-if-cumulative-edge-length-bigger-than", [](Parameters& param) { param.number("d1", &TreeDrawMod::d1); }},
+        {"before2015-58P-or-146I-or-559I", [](Parameters&) {}},
+        {"hide-between", [](Parameters& param) { param.text("s1", &TreeDrawMod::s1); param.text("s2", &TreeDrawMod::s2); }},
+        {"hide-one", [](Parameters& param) { param.text("s1", &TreeDrawMod::s1); }},
+        {"hide-not-found-in-chart", [](Parameters&) {}},
+        {"mark-with-line", [](Parameters& param) { param.text("s1", &TreeDrawMod::s1); param.color("s2", &TreeDrawMod::s2); param.number("d1", &TreeDrawMod::d1); }},
+        {"mark-aa-with-line", [](Parameters& param) { param.text("s1", &TreeDrawMod::s1); param.color("s2", &TreeDrawMod::s2); param.number("d1", &TreeDrawMod::d1); }},
+        {"mark-clade-with-line", [line](Parameters& param) { line(param, "clade", &TreeDrawMod::clade); }},
+        {"mark-country-with-line", [line](Parameters& param) { line(param, "country", &TreeDrawMod::country); }},
+        {"mark-location-with-line", [line](Parameters& param) { line(param, "location", &TreeDrawMod::location); }},
+        {"mark-having-serum-with-line", [](Parameters& param) { param.color("color", &TreeDrawMod::color); param.number("line_width", &TreeDrawMod::line_width); }},
+        {"mark-with-label", [](Parameters& param) {
+                                if (param.mod().seq_id.empty() && param.mod().name.empty())
+                                    param.error("seq_id", "either seq_id or name required by mod");
+                                param.color("label_color", &TreeDrawMod::label_color, false);
+                                param.color("line_color", &TreeDrawMod::line_color, false);
+                            }},
+    };
+
+    aSettings.tree_draw->mods.for_each([&errors, &schema](const TreeDrawMod& mod, size_t mod_no) {
+        Parameters param(mod, fmt::format("tree.mods[{}]", mod_no), errors);
+        const auto mod_mod = static_cast<std::string>(mod.mod);
+        if (mod_mod.empty() || mod_mod[0] == '?')
+            return;             // commented out mod
+        if (const auto found = schema.find(mod_mod); found != schema.end())
+            found->second(param);
+        else
+            param.error("mod", fmt::format("unrecognized tree mod \"{}\"", mod_mod));
+    });
+
+} // validate_tree_mods
+
+// ----------------------------------------------------------------------
+
+static void validate_antigenic_maps_mods(const Settings& aSettings, SettingsErrors& errors)
+{
+      // see AntigenicMapsLayoutDrawAce::prepare_apply_mods(), AntigenicMapsLayoutDraw::apply_mods_before(), AntigenicMapsLayoutDraw::apply_mods_after(),
+      // AntigenicMapsLayoutDrawAce::prepare_drawing_chart()
+    constexpr const std::array names{"antigens", "background", "border", "flip", "grid", "point_scale", "reference_antigens", "rotate", "rotate_degrees", "rotate_radians",
+                                     "sequenced_antigens", "sera", "serum_circle", "test_antigens", "text", "title", "tracked_antigen", "tracked_antigens", "tracked_antigens_egg", "tracked_sera",
+                                     "tracked_serum_circles", "viewport"};
+
+    aSettings.antigenic_maps->mods.for_each([&errors, &names](const AntigenicMapMod& mod, size_t mod_no) {
+        const auto path = fmt::format("antigenic_maps.mods[{}]", mod_no);
+        if (!mod.name.is_set_or_has_default()) {
+            if (!mod.name_commented.is_set_or_has_default())
+                errors.push_back(fmt::format("{}: mod N not set, and there is no ?N", path));
+            return;
+        }
+        if (const auto name = static_cast<std::string>(mod.name); name == "vaccines") { // thrown by AntigenicMapsLayoutDrawAce::prepare_drawing_chart()
+            errors.push_back(fmt::format("{}.N: obsolete mod \"vaccines\" (use {{\"N\":\"antigens\", \"select\": {{\"vaccine\": }}}})", path));
+        }
+        else if (name == "antigens_old") {
+            errors.push_back(fmt::format("{}.N: obsolete mod \"antigens_old\" (use {{\"N\":\"antigens\"}})", path));
+        }
+        else if (std::find(names.begin(), names.end(), name) == names.end()) {
+            errors.push_back(fmt::format("{}.N: unrecognized antigenic maps mod \"{}\"", path, name));
+        }
+        else if (name == "flip" && mod.direction.is_set()) {
+            if (const auto direction = static_cast<std::string>(mod.direction); direction != "ns" && direction != "ew")
+                errors.push_back(fmt::format("{}.direction: unrecognized flip value \"{}\"", path, direction));
+        }
+        check_color(errors, path + ".outline", mod.outline);
+        check_color(errors, path + ".fill", mod.fill);
+        check_color(errors, path + ".text_color", mod.text_color);
+        check_color(errors, path + ".color", mod.color);
+        check_color(errors, path + ".radius_line", mod.radius_line);
+        check_color(errors, path + ".serum_outline", mod.serum_outline);
+    });
+
+} // validate_antigenic_maps_mods
+
+// ----------------------------------------------------------------------
+
+std::vector<std::string> validate_settings(const Settings& aSettings)
+{
+    SettingsErrors errors;
+
+    check_value(errors, "signature_page.layout", [&aSettings]() { [[maybe_unused]] const SignaturePageLayout layout = *aSettings.signature_page->layout; });
+    check_value(errors, "tree.ladderize", [&aSettings]() { [[maybe_unused]] const Tree::LadderizeMethod ladderize = *aSettings.tree_draw->ladderize; });
+    if (const auto layout = static_cast<std::string>(aSettings.antigenic_maps->layout); layout != "labelled_grid") // see AntigenicMapsDraw::make_layout()
+        errors.push_back(fmt::format("antigenic_maps.layout: unrecognized antigenic maps layout \"{}\"", layout));
+    check_color(errors, "antigenic_maps.mapped_antigens_section_line_color", aSettings.antigenic_maps->mapped_antigens_section_line_color);
+
+    aSettings.mods.for_each([&errors](const SettingsMod& mod, size_t mod_no) {
+        if (mod.name.is_set_or_has_default()) {
+            if (const auto name = static_cast<std::string>(mod.name); name != "text") // see SignaturePageDraw::draw_mods()
+                errors.push_back(fmt::format("mods[{}].N: unrecognized mod \"{}\"", mod_no, name));
+        }
+        check_color(errors, fmt::format("mods[{}].color", mod_no), mod.color);
+    });
+
+    validate_tree_mods(aSettings, errors);
+
+    aSettings.clades->clades.for_each([&errors](const CladeDrawSettings& clade, size_t clade_no) {
+        check_value(errors, fmt::format("clades.clades[{}].label_position", clade_no), [&clade]() { [[maybe_unused]] const CladeDrawSettingsLabelPosition position = *clade.label_position; });
+        check_color(errors, fmt::format("clades.clades[{}].label_color", clade_no), clade.label_color);
+    });
+
+    validate_antigenic_maps_mods(aSettings, errors);
+
+    return errors;
+
+} // validate_settings
+
+// ----------------------------------------------------------------------
+
+std::vector<std::string> validate_settings(const Settings& aSettings, Tree& aTree)
+{
+    SettingsErrors errors;
+    const auto check_seq_id = [&errors, &aTree](std::string_view path, std::string seq_id) {
+        if (!seq_id.empty() && aTree.find_leaf_by_seqid(seq_id) == nullptr)
+            errors.push_back(fmt::format("{}: seq_id \"{}\" not found in the tree", path, seq_id));
+    };
+
+    aSettings.hz_sections->sections.for_each([&check_seq_id](const HzSection& section, size_t section_no) {
+        if (section.aa_transition.empty()) // aa transition based sections are converted to name based ones using tree
+            check_seq_id(fmt::format("hz_sections.sections[{}].name", section_no), *section.name);
+    });
+
+    aSettings.tree_draw->mods.for_each([&check_seq_id](const TreeDrawMod& mod, size_t mod_no) {
+        if (const auto mod_mod = static_cast<std::string>(mod.mod); mod_mod == "hide-between") {
+            check_seq_id(fmt::format("tree.mods[{}].s1", mod_no), *mod.s1);
+            check_seq_id(fmt::format("tree.mods[{}].s2", mod_no), *mod.s2);
+        }
+        else if (mod_mod == "mark-with-label")
+            check_seq_id(fmt::format("tree.mods[{}].seq_id", mod_no), *mod.seq_id);
+    });
+
+    return errors;
+
+} // validate_settings
+
+// ----------------------------------------------------------------------
+
+std::vector<std::string> compare_settings_files(std::string_view aExpected, std::string_view aActual)
+{
+    json_compare::Options options;
+    options.ignore_keys.emplace(" timestamp"); // updated by write_settings()
+    return json_compare::compare_files(aExpected, aActual, options);
+
+} // compare_settings_files
+
 // ----------------------------------------------------------------------
 /// Local Variables:
 /// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
@@ -56,6 +56,17 @@ class Settings : public acmacs::settings::v1::toplevel
 void read_settings(Settings& aSettings, std::string_view aFilename);
 void write_settings(const Settings& aSettings, std::string_view aFilename);
 
+// Checks mod names and parameters, enums and colors without loading tree, seqdb and chart,
+// returns all errors found, each error is prefixed with the json path, e.g. "tree.mods[2].s2"
+std::vector<std::string> validate_settings(const Settings& aSettings);
+// Checks that seq_ids referred by settings are in the tree, tree does not need to be matched against seqdb,
+// returned mismatches are reported as warnings unless sigp --strict is used
+std::vector<std::string> validate_settings(const Settings& aSettings, Tree& aTree);
+
+// Structural comparison of settings files (timestamp is ignored), returns differences prefixed with json paths, empty if settings are the same.
+// To test round trips of read_settings()/write_settings() and regressions of SignaturePageDraw::write_initialized_settings().
+std::vector<std::string> compare_settings_files(std::string_view aExpected, std::string_view aActual);
+
 // ----------------------------------------------------------------------
 /// Local Variables:
 /// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
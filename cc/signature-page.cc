@@ -41,6 +41,34 @@ void SignaturePageDraw::load_settings(std::string_view aFilename)
 
 // ----------------------------------------------------------------------
 
+static void report_settings_errors(const std::vector<std::string>& errors)
+{
+    if (!errors.empty()) {
+        for (const auto& error : errors)
+            fmt::print(stderr, "ERROR: settings: {}\n", error);
+        throw std::runtime_error(fmt::format("{} error(s) in settings", errors.size()));
+    }
+}
+
+// the same settings are often used with trees of different subsets, seq_ids not found are not fatal unless strict
+static void report_settings_tree_mismatch(const std::vector<std::string>& mismatches, bool strict)
+{
+    if (strict)
+        report_settings_errors(mismatches);
+    else {
+        for (const auto& mismatch : mismatches)
+            fmt::print(stderr, "WARNING: settings: {}\n", mismatch);
+    }
+}
+
+void SignaturePageDraw::validate_settings() const
+{
+    report_settings_errors(::validate_settings(*mSettings));
+
+} // SignaturePageDraw::validate_settings
+
+// ----------------------------------------------------------------------
+
 SignaturePageLayout SignaturePageDraw::detect_layout(bool init_settings, bool show_aa_at_pos) const
 {
     const auto layout = *mSettings->signature_page->layout;
@@ -176,16 +204,42 @@ void SignaturePageDraw::write_initialized_settings(std::string_view aFilename)
 void SignaturePageDraw::tree(std::string_view aTreeFilename)
 {
     tree::tree_import(aTreeFilename, *mTree);
-    mTree->match_seqdb();
+    report_settings_tree_mismatch(::validate_settings(*mSettings, *mTree), mStrictSettings); // before loading seqdb
+    tree::match_seqdb(*mTree, aTreeFilename);
+
+} // SignaturePageDraw::tree
+
+// ----------------------------------------------------------------------
+
+void SignaturePageDraw::tree(const Tree& aTree)
+{
+    *mTree = aTree;             // tree is modified by mods, ladderizing, etc.
+    report_settings_tree_mismatch(::validate_settings(*mSettings, *mTree), mStrictSettings);
 
 } // SignaturePageDraw::tree
 
 // ----------------------------------------------------------------------
 
+void SignaturePageDraw::preview(double aDpi)
+{
+    const double device_pixel = 72.0 / aDpi; // surface pixels are pdf points
+    if (mTreeDraw)
+        mTreeDraw->preview(device_pixel);
+    if (mAAAtPosDraw)
+        mAAAtPosDraw->preview(true);
+    if (mAntigenicMapsDraw)
+        mAntigenicMapsDraw->preview(true);
+
+} // SignaturePageDraw::preview
+
+// ----------------------------------------------------------------------
+
 void SignaturePageDraw::prepare(bool show_hz_sections)
 {
     std::cout << "\nINFO: PREPARE **********************************************************************\n\n";
     settings().hz_sections->show = show_hz_sections;
+    if (mMappedAntigensDraw)
+        mMappedAntigensDraw->prepare(); // before tree mods (hide-not-found-in-chart) are applied
     switch (detect_layout(false, false)) {
       case SignaturePageLayout::TreeTSClades:
       case SignaturePageLayout::TreeTSCladesWide:
@@ -201,14 +255,13 @@ void SignaturePageDraw::prepare(bool show_hz_sections)
       case SignaturePageLayout::TreeCladesTSMaps:
           if (mChartFilename.empty())
               throw std::runtime_error("Cannot generate page in the TreeCladesTSMaps layout: no chart provided (--chart)");
+          mTreeDraw->prepare_sections(); // grid of antigenic maps is solved for the final hz sections
           make_layout_tree_clades_ts_maps();
           if (mTimeSeriesDraw)
               mTimeSeriesDraw->tree_mode(false);
           break;
     }
 
-    if (mMappedAntigensDraw)
-        mMappedAntigensDraw->prepare();
     if (mAAAtPosDraw)
         mAAAtPosDraw->prepare();
     if (mTitleDraw)
@@ -260,12 +313,13 @@ void SignaturePageDraw::make_layout_tree_clades_ts_maps()
     const acmacs::Size& page_size = mSurface->viewport().size;
     const double section_height = page_size.height - (mSettings->signature_page->top + mSettings->signature_page->bottom);
 
-    const double antigic_maps_width = mSettings->signature_page->antigenic_maps_width;
     const double mapped_antigens_width = mSettings->mapped_antigens->width;
     const double clades_width = mSettings->signature_page->clades_width;
     const double ts_width = mSettings->signature_page->time_series_width;
-    const double tree_width = page_size.width - (mSettings->signature_page->left + mSettings->signature_page->tree_margin_right + ts_width + clades_width + mapped_antigens_width +
-                                                 mSettings->signature_page->mapped_antigens_margin_right + antigic_maps_width + mSettings->signature_page->right);
+    const double other_width = mSettings->signature_page->left + mSettings->signature_page->tree_margin_right + ts_width + clades_width + mapped_antigens_width +
+                               mSettings->signature_page->mapped_antigens_margin_right + mSettings->signature_page->right;
+    const double antigic_maps_width = mAntigenicMapsDraw->solve_grid(section_height, page_size.width - other_width - mSettings->signature_page->tree_min_width);
+    const double tree_width = page_size.width - other_width - antigic_maps_width;
 
     const double clades_left = mSettings->signature_page->left + tree_width + mSettings->signature_page->tree_margin_right;
     const double ts_left = clades_left + clades_width;
@@ -298,10 +352,21 @@ void SignaturePageDraw::draw(bool report_antigens_in_hz_sections, bool init_sett
     if (init_settings)
         mSettings->aa_at_pos->small_section_threshold = aa_small_section_threshold;
 
+    if (mAAAtPosDraw)
+        mAAAtPosDraw->prepare_draw(init_settings, hz_section_threshold); // modifies hz sections
+
+      // panels compute their drawing (tree and settings are not modified) before anything is drawn on the surface
+    if (mTreeDraw)
+        mTreeDraw->prepare_draw();
+    if (mTimeSeriesDraw)
+        mTimeSeriesDraw->prepare_draw();
+    if (mMappedAntigensDraw)
+        mMappedAntigensDraw->prepare_draw();
+
     if (mTreeDraw)
         mTreeDraw->draw();
     if (mAAAtPosDraw)
-        mAAAtPosDraw->draw(init_settings, hz_section_threshold);
+        mAAAtPosDraw->draw();
     if (mTimeSeriesDraw)
         mTimeSeriesDraw->draw();
     if (mCladesDraw)
@@ -78,7 +78,9 @@ class SignaturePageDrawSettings : public acmacs::settings::v1::object
         mapped_antigens_margin_right{this, "mapped_antigens_margin_right", 10},
         time_series_width{this, "time_series_width", 400},
         clades_width{this, "clades_width", 100},
-        antigenic_maps_width{this, "antigenic_maps_width"}; // , 300};
+        antigenic_maps_width{this, "antigenic_maps_width"}, // , 300};
+        tree_min_width{this, "tree_min_width", 250};         // constraint for the solved antigenic_maps_width
+    acmacs::settings::v1::field<bool> antigenic_maps_width_auto{this, "antigenic_maps_width_auto", false}; // antigenic_maps_width solved in prepare even if it is set, unset width is always solved
 
 }; // class SignaturePageDrawSettings
 
@@ -91,17 +93,21 @@ class SignaturePageDraw
     // ~SignaturePageDraw();
 
     void load_settings(std::string_view aFilename);
+    void validate_settings() const; // before loading tree and chart, throws after reporting all errors found
     void make_surface(std::string_view aFilename, bool init_settings, bool show_aa_at_pos, bool draw_map);
     void init_settings(bool show_aa_at_pos, bool whocc_support);
     void write_initialized_settings(std::string_view aFilename); // removes redundant settings entries depending on layout!
     Settings& settings() { return *mSettings; }
+    void strict_settings(bool aStrict) { mStrictSettings = aStrict; } // before tree(): seq_ids of settings not found in the tree are errors rather than warnings
     void tree(std::string_view aTreeFilename);
+    void tree(const Tree& aTree); // copy of the imported and seqdb matched tree, e.g. shared by sigp --batch jobs
     Tree& tree() { return *mTree; }
     const TreeDraw& tree_draw() const { return *mTreeDraw; }
     void chart(std::string_view aChartFilename) { mChartFilename = aChartFilename; }
     bool has_antigenic_maps_draw() const noexcept { return bool{mMappedAntigensDraw}; }
     const AntigenicMapsDrawBase& antigenic_maps_draw() const { return *mAntigenicMapsDraw; }
 
+    void preview(double aDpi); // after make_surface(), before prepare(): skip illegible and expensive elements, settings are not changed
     void prepare(bool show_hz_sections);
     void draw(bool report_antigens_in_hz_sections, bool init_settings, size_t hz_section_threshold, size_t aa_small_section_threshold);
 
@@ -117,6 +123,7 @@ class SignaturePageDraw
     std::unique_ptr<AAAtPosDraw> mAAAtPosDraw;
     std::unique_ptr<AntigenicMapsDrawBase> mAntigenicMapsDraw;
     std::unique_ptr<TitleDraw> mTitleDraw;
+    bool mStrictSettings = false;
 
     SignaturePageLayout detect_layout(bool init_settings, bool show_aa_at_pos) const;
     void make_layout_tree_ts_clades();
@@ -1,13 +1,30 @@
 #include <fstream>
 #include <string>
+#include <filesystem>
+#include <cstdlib>
+#include <map>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "acmacs-base/argv.hh"
 #include "acmacs-base/file-stream.hh"
 #include "acmacs-base/quicklook.hh"
-#include "seqdb-3/seqdb.hh"
+#include "signature-page/tree-export.hh"
+#include "signature-page/chart-cache.hh"
 
 #include "signature-page.hh"
 #include "settings.hh"
+#include "text-measure.hh"
+#include "line-batch.hh"
 
 // ----------------------------------------------------------------------
 
@@ -32,66 +49,89 @@ struct Options : public argv
     option<str>       report_first_node_of_subtree{*this, "report-first-node-of-subtree", desc{"filename or - to report subtree data"}};
     option<size_t>    subtree_threshold{*this, "subtree-threshold", desc{"min number of leaf nodes in a subtree for --report-first-node-of-subtree"}};
     option<str>       list_ladderized{*this, "list-ladderized"};
+    option<str>       export_tree{*this, "export-tree", desc{"export tree with seqdb data (phylogenetic-tree-v3) to use it without seqdb"}};
+    option<bool>      strict{*this, "strict", desc{"hz sections and tree mods referring to seq_ids not found in the tree are errors instead of warnings"}};
     option<bool>      no_draw{*this, "no-draw", desc{"do not generate pdf"}};
+    option<str>       preview{*this, "preview", desc{"generate low resolution png preview (illegible labels, aa letters and serum circles are not drawn) instead of output.pdf"}};
+    option<double>    preview_dpi{*this, "preview-dpi", dflt{72.0}, desc{"resolution of --preview"}};
+    option<bool>      validate_text_measure{*this, "validate-text-measure", desc{"compare cached text measurements with cairo and report differences"}};
     option<str>       chart{*this, "chart", desc{"path to a chart for the signature page"}};
+    option<str>       chart_cache{*this, "chart-cache", desc{"directory to keep uncompressed snapshots of charts in, speeds up importing the same chart again"}};
     option<bool>      open{*this, "open"};
     option<bool>      ql{*this, "ql"};
     option<bool>      verbose{*this, 'v', "verbose"};
 
-    argument<str> tree_file{*this, arg_name{"tree.json[.xz]"}, mandatory};
-    argument<str> output_pdf{*this, arg_name{"output.pdf"}, mandatory};
+    option<str>       batch{*this, "batch", desc{"jobs.json: draw several signature pages in one process sharing seqdb and trees, tree.json and output.pdf are not used"}};
+    option<size_t>    batch_threads{*this, "batch-threads", dflt{1UL}, desc{"number of --batch jobs run at the same time, each in a separate process, output of a job is printed when it finishes"}};
+
+    argument<str> tree_file{*this, arg_name{"tree.json[.xz]"}};
+    argument<str> output_pdf{*this, arg_name{"output.pdf"}};
+};
+
+// one signature page: options given in the command line or a job of --batch
+struct Job
+{
+    std::vector<std::string> settings_files;
+    std::string tree_file;
+    std::string chart;
+    std::string output_pdf;
+    std::string init_settings;
+};
+
+static void run_job(const Options& opt, const Job& job, const Tree* aTree);
+static int run_batch(const Options& opt);
+
+struct JobResult
+{
+    double seconds = 0;
+    std::string error;
+};
+
+static void run_jobs_in_processes(const Options& opt, const std::vector<Job>& jobs, const std::map<std::string, Tree, std::less<>>& trees, std::vector<JobResult>& results);
+static void rasterize_preview(std::string_view aPdf, std::string_view aPng, double aDpi);
+extern char** environ;
+
+struct RemoveFileOnExit        // intermediate pdf of --preview is removed whether or not drawing and rasterizing succeeded
+{
+    RemoveFileOnExit(std::string_view aFilename) : filename{aFilename} {}
+    ~RemoveFileOnExit() { std::error_code ec; std::filesystem::remove(filename, ec); }
+    RemoveFileOnExit(const RemoveFileOnExit&) = delete;
+    RemoveFileOnExit& operator=(const RemoveFileOnExit&) = delete;
+    const std::string filename;
 };
 
 int main(int argc, const char* argv[])
 {
     try {
         Options opt(argc, argv);
-        acmacs::seqdb::setup(opt.seqdb);
-
-        {
-            SignaturePageDraw signature_page;
-
-            if (!opt.settings_files->empty()) {
-                for (auto fn : *opt.settings_files) {
-                    if (opt.verbose)
-                        AD_DEBUG("reading settings from {}", fn);
-                    signature_page.load_settings(fn);
-                }
-            }
+        tree::seqdb_setup(opt.seqdb);
+        chart_cache::setup(opt.chart_cache);
+        TextMeasure::get().validate(opt.validate_text_measure);
+        if (!opt.batch->empty())
+            return run_batch(opt);
+        if (opt.tree_file->empty() || opt.output_pdf->empty())
+            throw std::runtime_error("tree.json and output.pdf expected, or use --batch");
 
-            signature_page.tree(opt.tree_file);
-            if (!opt.chart->empty())
-                signature_page.chart(opt.chart);                                                                        // before make_surface!
-            signature_page.make_surface(opt.output_pdf, !opt.init_settings->empty(), opt.show_aa_at_pos, !opt.no_draw); // before init_layout!
-            if (!opt.init_settings->empty()) {
-                signature_page.init_settings(opt.show_aa_at_pos, !opt.no_whocc);
-            }
-            signature_page.prepare(!opt.not_show_hz_sections);
-            if (!opt.report_cumulative->empty()) {
-                acmacs::file::ofstream out(opt.report_cumulative);
-                signature_page.tree().report_cumulative_edge_length(out);
-            }
-            if (!opt.list_ladderized->empty()) {
-                AD_INFO("listing ladderized {}", opt.list_ladderized);
-                acmacs::file::ofstream out(opt.list_ladderized);
-                signature_page.tree().list_strains(out);
-            }
-            if (!opt.report_first_node_of_subtree->empty()) {
-                AD_INFO("reporting first-node-of-subtree to {}", opt.report_first_node_of_subtree);
-                acmacs::file::ofstream out(opt.report_first_node_of_subtree);
-                signature_page.tree().report_first_node_of_subtree(out, opt.subtree_threshold);
-            }
-            if (!opt.no_draw)
-                signature_page.draw(opt.report_hz_section_antigens, !opt.init_settings->empty(), opt.aa_at_pos_hz_section_threshold, opt.aa_at_pos_small_section_threshold);
-            if (!opt.init_settings->empty())
-                signature_page.write_initialized_settings(opt.init_settings);
-            if (opt.hz_sections_report)
-                signature_page.tree_draw().hz_sections().report(std::cout);
-            // if (!opt.hz_sections_report_html->empty())
-            //     signature_page.tree_draw().hz_sections().report_html(opt.hz_sections_report_html);
+        Job job;
+        if (!opt.settings_files->empty()) {
+            for (auto fn : *opt.settings_files)
+                job.settings_files.emplace_back(fn);
         }
+        job.tree_file = std::string{opt.tree_file};
+        job.chart = std::string{opt.chart};
+        job.output_pdf = opt.preview->empty() ? std::string{opt.output_pdf} : std::string{opt.preview} + ".pdf";
+        job.init_settings = std::string{opt.init_settings};
+        std::optional<RemoveFileOnExit> preview_pdf;
+        if (!opt.preview->empty())
+            preview_pdf.emplace(job.output_pdf);
+        run_job(opt, job, nullptr);
 
-        if (!opt.no_draw) {
+        if (!opt.no_draw && !opt.preview->empty()) {
+            rasterize_preview(job.output_pdf, opt.preview, opt.preview_dpi);
+            AD_INFO("generated: {}", opt.preview);
+            acmacs::open_or_quicklook(opt.open, opt.ql, opt.preview, 2);
+        }
+        else if (!opt.no_draw) {
             AD_INFO("generated: {}", opt.output_pdf);
             acmacs::open_or_quicklook(opt.open, opt.ql, opt.output_pdf, 2);
         }
@@ -104,6 +144,257 @@ int main(int argc, const char* argv[])
     }
 }
 
+// ----------------------------------------------------------------------
+
+// pdf is written when this function returns
+void run_job(const Options& opt, const Job& job, const Tree* aTree)
+{
+    SignaturePageDraw signature_page;
+
+    for (const auto& fn : job.settings_files) {
+        if (opt.verbose)
+            AD_DEBUG("reading settings from {}", fn);
+        signature_page.load_settings(fn);
+    }
+    signature_page.validate_settings();
+    signature_page.strict_settings(opt.strict);
+
+    if (aTree)
+        signature_page.tree(*aTree);
+    else
+        signature_page.tree(job.tree_file);
+    if (!opt.export_tree->empty()) {
+        AD_INFO("exporting tree with seqdb data to {}", opt.export_tree);
+        signature_page.tree().set_continents();
+        tree::export_to_json_with_seqdb_data(opt.export_tree, signature_page.tree(), 1);
+    }
+    if (!job.chart.empty())
+        signature_page.chart(job.chart);                                                                        // before make_surface!
+    signature_page.make_surface(job.output_pdf, !job.init_settings.empty(), opt.show_aa_at_pos, !opt.no_draw); // before init_layout!
+    if (!opt.preview->empty())
+        signature_page.preview(opt.preview_dpi);
+    if (!job.init_settings.empty()) {
+        signature_page.init_settings(opt.show_aa_at_pos, !opt.no_whocc);
+    }
+    signature_page.prepare(!opt.not_show_hz_sections);
+    if (!opt.report_cumulative->empty()) {
+        acmacs::file::ofstream out(opt.report_cumulative);
+        signature_page.tree().report_cumulative_edge_length(out);
+    }
+    if (!opt.list_ladderized->empty()) {
+        AD_INFO("listing ladderized {}", opt.list_ladderized);
+        acmacs::file::ofstream out(opt.list_ladderized);
+        signature_page.tree().list_strains(out);
+    }
+    if (!opt.report_first_node_of_subtree->empty()) {
+        AD_INFO("reporting first-node-of-subtree to {}", opt.report_first_node_of_subtree);
+        acmacs::file::ofstream out(opt.report_first_node_of_subtree);
+        signature_page.tree().report_first_node_of_subtree(out, opt.subtree_threshold);
+    }
+    if (!opt.no_draw) {
+        signature_page.draw(opt.report_hz_section_antigens, !job.init_settings.empty(), opt.aa_at_pos_hz_section_threshold, opt.aa_at_pos_small_section_threshold);
+        if (opt.verbose || opt.validate_text_measure)
+            TextMeasure::get().report();
+        if (opt.verbose)
+            LineBatch::report();
+    }
+    if (!job.init_settings.empty())
+        signature_page.write_initialized_settings(job.init_settings);
+    if (opt.hz_sections_report)
+        signature_page.tree_draw().hz_sections().report(std::cout);
+    // if (!opt.hz_sections_report_html->empty())
+    //     signature_page.tree_draw().hz_sections().report_html(opt.hz_sections_report_html);
+
+} // run_job
+
+// ----------------------------------------------------------------------
+
+// jobs.json: {"jobs": [{"tree": "h3.tree.json.xz", "settings": ["h3.tree.settings.json", "cdc-h3-hi.sp.settings.json"], "chart": "cdc-h3-hi.ace", "output": "cdc-h3-hi.sp.pdf", "init_settings": ""}]}
+// Each tree is imported, matched against seqdb and assigned continents once, jobs draw copies of it.
+// A failed job is reported, other jobs are run anyway. With --batch-threads > 1 jobs are run in separate processes, see run_jobs_in_processes().
+int run_batch(const Options& opt)
+{
+    const auto jobs_data = rjson::parse_file(opt.batch);
+    std::vector<Job> jobs;
+    rjson::for_each(jobs_data["jobs"], [&jobs](const rjson::value& job_data) {
+        auto& job = jobs.emplace_back();
+        rjson::for_each(job_data["settings"], [&job](const rjson::value& fn) { job.settings_files.emplace_back(fn.to<std::string_view>()); });
+        job.tree_file = job_data["tree"].to<std::string_view>();
+        job.output_pdf = job_data["output"].to<std::string_view>();
+        if (const auto& chart = job_data["chart"]; !chart.is_null())
+            job.chart = chart.to<std::string_view>();
+        if (const auto& init_settings = job_data["init_settings"]; !init_settings.is_null())
+            job.init_settings = init_settings.to<std::string_view>();
+    });
+
+    std::map<std::string, Tree, std::less<>> trees;
+    std::map<std::string, std::string, std::less<>> tree_errors; // tree file -> error, jobs using the tree fail, other jobs are run
+    for (const auto& job : jobs) {
+        if (trees.find(job.tree_file) == trees.end() && tree_errors.find(job.tree_file) == tree_errors.end()) {
+            try {
+                auto& tree = trees[job.tree_file];
+                tree::tree_import(job.tree_file, tree);
+                tree::match_seqdb(tree, job.tree_file);
+                tree.set_continents();
+            }
+            catch (std::exception& err) {
+                fmt::print(stderr, "ERROR: tree {}: {}\n", job.tree_file, err.what());
+                trees.erase(job.tree_file);
+                tree_errors.emplace(job.tree_file, fmt::format("tree {}: {}", job.tree_file, err.what()));
+            }
+        }
+    }
+
+    std::vector<JobResult> results(jobs.size());
+    for (size_t job_no = 0; job_no < jobs.size(); ++job_no) {
+        if (const auto found = tree_errors.find(jobs[job_no].tree_file); found != tree_errors.end())
+            results[job_no].error = found->second; // job is not run
+    }
+    if (opt.batch_threads < 2 || jobs.size() < 2) {
+        for (size_t job_no = 0; job_no < jobs.size(); ++job_no) {
+            if (!results[job_no].error.empty())
+                continue;
+            const auto start = std::chrono::steady_clock::now();
+            try {
+                run_job(opt, jobs[job_no], &trees.find(jobs[job_no].tree_file)->second);
+            }
+            catch (std::exception& err) {
+                results[job_no].error = err.what();
+            }
+            results[job_no].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+    else
+        run_jobs_in_processes(opt, jobs, trees, results);
+
+    size_t failed = 0;
+    for (size_t job_no = 0; job_no < jobs.size(); ++job_no) {
+        if (results[job_no].error.empty()) {
+            fmt::print("INFO: job {} {}: {:.1f}s\n", job_no, jobs[job_no].output_pdf, results[job_no].seconds);
+        }
+        else {
+            fmt::print(stderr, "ERROR: job {} {}: {:.1f}s: {}\n", job_no, jobs[job_no].output_pdf, results[job_no].seconds, results[job_no].error);
+            ++failed;
+        }
+    }
+    fmt::print("INFO: jobs: {} failed: {}\n", jobs.size(), failed);
+    return failed ? 1 : 0;
+
+} // run_batch
+
+// ----------------------------------------------------------------------
+
+// Each job is run in a forked process, seqdb and trees loaded by run_batch() are shared copy-on-write.
+// Stdout and stderr of a job are collected in a temporary file and printed, each line prefixed with the job number,
+// when the job finishes, i.e. output of jobs run at the same time is not interleaved.
+void run_jobs_in_processes(const Options& opt, const std::vector<Job>& jobs, const std::map<std::string, Tree, std::less<>>& trees, std::vector<JobResult>& results)
+{
+    struct Running
+    {
+        size_t job_no;
+        std::FILE* output;
+        std::chrono::steady_clock::time_point start;
+    };
+    std::map<pid_t, Running> running;
+
+    const auto wait_for_job = [&running, &jobs, &results]() {
+        int status = 0;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, 0)) < 0) {
+            if (errno != EINTR)
+                throw std::runtime_error(fmt::format("waiting for batch jobs: {}", std::strerror(errno)));
+        }
+        if (const auto found = running.find(pid); found != running.end()) {
+            const auto [job_no, output, start] = found->second;
+            running.erase(found);
+            results[job_no].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::rewind(output);
+            std::string line;
+            for (int ch = std::fgetc(output); ch != EOF; ch = std::fgetc(output)) {
+                if (ch == '\n') {
+                    fmt::print("[job {}] {}\n", job_no, line);
+                    line.clear();
+                }
+                else
+                    line.push_back(static_cast<char>(ch));
+            }
+            if (!line.empty())
+                fmt::print("[job {}] {}\n", job_no, line);
+            std::fclose(output);
+            if (!WIFEXITED(status))
+                results[job_no].error = "terminated by signal";
+            else if (WEXITSTATUS(status) != 0)
+                results[job_no].error = fmt::format("exit status {}, see [job {}] output", WEXITSTATUS(status), job_no);
+        }
+    };
+
+    for (size_t job_no = 0; job_no < jobs.size(); ++job_no) {
+        if (!results[job_no].error.empty()) // tree of the job could not be imported
+            continue;
+        while (running.size() >= opt.batch_threads)
+            wait_for_job();
+        std::FILE* output = std::tmpfile();
+        if (!output)
+            throw std::runtime_error(fmt::format("cannot create temporary file for output of job {}: {}", job_no, std::strerror(errno)));
+        std::cout.flush();
+        std::fflush(nullptr);   // otherwise buffered output is written by both processes
+        const pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error(fmt::format("cannot start job {}: {}", job_no, std::strerror(errno)));
+        if (pid == 0) {
+            dup2(fileno(output), STDOUT_FILENO);
+            dup2(fileno(output), STDERR_FILENO);
+            int exit_code = 0;
+            try {
+                run_job(opt, jobs[job_no], &trees.find(jobs[job_no].tree_file)->second);
+            }
+            catch (std::exception& err) {
+                fmt::print(stderr, "> ERROR {}\n", err.what());
+                exit_code = 1;
+            }
+            std::cout.flush();
+            std::fflush(nullptr);
+            _exit(exit_code);   // no atexit handlers and destructors of statics, they belong to the parent
+        }
+        running.emplace(pid, Running{job_no, output, std::chrono::steady_clock::now()});
+    }
+    while (!running.empty())
+        wait_for_job();
+
+} // run_jobs_in_processes
+
+// ----------------------------------------------------------------------
+
+// pdf surface is written when SignaturePageDraw is destroyed, it is then rasterized by poppler (pdftocairo is run directly, not via shell)
+// pdf is removed by RemoveFileOnExit in main()
+void rasterize_preview(std::string_view aPdf, std::string_view aPng, double aDpi)
+{
+    std::string png_stem{aPng}; // pdftocairo adds .png
+    if (png_stem.size() > 4 && png_stem.substr(png_stem.size() - 4) == ".png")
+        png_stem.resize(png_stem.size() - 4);
+    std::vector<std::string> args{"pdftocairo", "-png", "-singlefile", "-r", fmt::format("{}", aDpi), std::string{aPdf}, png_stem};
+    std::vector<char*> argv;
+    for (auto& arg : args)
+        argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    if (const auto err = posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ); err != 0) {
+        if (err == ENOENT)
+            throw std::runtime_error("preview rasterizing failed: pdftocairo (poppler-utils) not found in PATH");
+        throw std::runtime_error(fmt::format("preview rasterizing failed: cannot run pdftocairo: {}", std::strerror(err)));
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR)
+            throw std::runtime_error(fmt::format("preview rasterizing failed: waiting for pdftocairo: {}", std::strerror(errno)));
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        throw std::runtime_error(fmt::format("preview rasterizing failed: pdftocairo {} -> {}: {}", aPdf, aPng,
+                                             WIFEXITED(status) ? fmt::format("exit status {}", WEXITSTATUS(status)) : std::string{"terminated by signal"}));
+
+} // rasterize_preview
+
 // ----------------------------------------------------------------------
 /// Local Variables:
 /// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
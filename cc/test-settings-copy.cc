@@ -1,5 +1,4 @@
 #include <iostream>
-#include <cstdlib>
 
 #include "settings.hh"
 #include "acmacs-base/read-file.hh"
@@ -23,8 +22,11 @@ int main(int argc, const char *argv[])
             output = static_cast<std::string>(acmacs::file::temp{".json"});
         write_settings(settings, output);
           // std::cout << static_cast<std::string>(output) << '\n';
-        if (std::system((std::string{"/usr/bin/diff -b '"} + argv[1] + "' '" + static_cast<std::string>(output) + "'").c_str()))
+        if (const auto differences = compare_settings_files(argv[1], output); !differences.empty()) {
+            for (const auto& difference : differences)
+                std::cerr << difference << '\n';
             throw std::runtime_error("FAILED");
+        }
     }
     catch (std::exception& err) {
         std::cerr << err.what() << '\n';
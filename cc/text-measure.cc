@@ -0,0 +1,145 @@
+#include <cmath>
+#include <algorithm>
+
+#include "acmacs-base/fmt.hh"
+#include "signature-page/text-measure.hh"
+
+// ----------------------------------------------------------------------
+
+TextMeasure& TextMeasure::get()
+{
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wexit-time-destructors"
+#endif
+    static TextMeasure text_measure;
+#pragma GCC diagnostic pop
+    return text_measure;
+
+} // TextMeasure::get
+
+// ----------------------------------------------------------------------
+
+acmacs::Size TextMeasure::text_size(acmacs::surface::Surface& aSurface, std::string_view aText, Scaled aSize, const acmacs::TextStyle& aStyle, double* x_bearing)
+{
+    std::lock_guard<std::mutex> lock{mAccess};
+
+    const auto face_no = face_index(aStyle);
+    lru_key_t key{face_no, std::string{aText}};
+    Measured measured;
+    if (const auto found = mLRUIndex.find(key); found != mLRUIndex.end()) {
+        ++mHits;
+        mLRU.splice(mLRU.begin(), mLRU, found->second);
+        measured = found->second->second;
+    }
+    else {
+        ++mMisses;
+        measured = measure(aSurface, mFaces[face_no], aText, aSize);
+        mLRU.emplace_front(key, measured);
+        mLRUIndex.emplace(std::move(key), mLRU.begin());
+        if (mLRU.size() > LRUCapacity) {
+            mLRUIndex.erase(mLRU.back().first);
+            mLRU.pop_back();
+        }
+    }
+
+    if (mValidate) {
+        if (const auto cairo = measure_cairo(aSurface, aStyle, aText, aSize); std::abs(cairo.width - measured.width) > mValidateTolerance || std::abs(cairo.height - measured.height) > mValidateTolerance) {
+            ++mValidationFailures;
+            fmt::print(stderr, "WARNING: TextMeasure: \"{}\" per font size: {}x{} cairo: {}x{}\n", aText, measured.width, measured.height, cairo.width, cairo.height);
+        }
+    }
+
+    const double size = aSize.value();
+    if (x_bearing)
+        *x_bearing = measured.x_bearing * size;
+    return {measured.width * size, measured.height * size};
+
+} // TextMeasure::text_size
+
+// ----------------------------------------------------------------------
+
+void TextMeasure::report() const
+{
+    std::lock_guard<std::mutex> lock{mAccess};
+    fmt::print("INFO: text measurements: {} cached: {} measured: {} cairo calls: {} faces: {}", mHits + mMisses, mHits, mMisses, mCairoCalls, mFaces.size());
+    if (mValidate)
+        fmt::print(" validation failures: {}", mValidationFailures);
+    fmt::print("\n");
+
+} // TextMeasure::report
+
+// ----------------------------------------------------------------------
+
+size_t TextMeasure::face_index(const acmacs::TextStyle& aStyle)
+{
+    const auto found = std::find_if(mFaces.begin(), mFaces.end(), [&aStyle](const Face& face) {
+        return face.style.font_family == aStyle.font_family && face.style.slant == aStyle.slant && face.style.weight == aStyle.weight;
+    });
+    if (found != mFaces.end())
+        return static_cast<size_t>(found - mFaces.begin());
+    mFaces.emplace_back(aStyle);
+    return mFaces.size() - 1;
+
+} // TextMeasure::face_index
+
+// ----------------------------------------------------------------------
+
+TextMeasure::Measured TextMeasure::measure(acmacs::surface::Surface& aSurface, Face& aFace, std::string_view aText, Scaled aSize)
+{
+    if (aText.empty())
+        return {0, 0, 0};
+    if (std::any_of(aText.begin(), aText.end(), [&aFace](char glyph) { return static_cast<unsigned char>(glyph) >= aFace.glyphs.size(); })) // non-ascii (utf-8), no glyph table
+        return measure_cairo(aSurface, aFace.style, aText, aSize);
+
+    Measured result{0, 0, glyph(aSurface, aFace, aText.front(), aSize).x_bearing};
+    for (size_t index = 0; index < aText.size(); ++index) {
+        const auto& measured_glyph = glyph(aSurface, aFace, aText[index], aSize);
+        result.width += measured_glyph.width;
+        result.height = std::max(result.height, measured_glyph.height);
+        if (index > 0)
+            result.width += kerning(aSurface, aFace, aText[index - 1], aText[index], aSize);
+    }
+    return result;
+
+} // TextMeasure::measure
+
+// ----------------------------------------------------------------------
+
+TextMeasure::Measured TextMeasure::measure_cairo(acmacs::surface::Surface& aSurface, const acmacs::TextStyle& aStyle, std::string_view aText, Scaled aSize)
+{
+    ++mCairoCalls;
+    double x_bearing = 0;
+    const auto size = aSurface.text_size(aText, aSize, aStyle, &x_bearing);
+    return {size.width / aSize.value(), size.height / aSize.value(), x_bearing / aSize.value()};
+
+} // TextMeasure::measure_cairo
+
+// ----------------------------------------------------------------------
+
+const TextMeasure::Measured& TextMeasure::glyph(acmacs::surface::Surface& aSurface, Face& aFace, char aGlyph, Scaled aSize)
+{
+    auto& measured = aFace.glyphs[static_cast<unsigned char>(aGlyph)];
+    if (measured.width < 0)
+        measured = measure_cairo(aSurface, aFace.style, std::string_view(&aGlyph, 1), aSize);
+    return measured;
+
+} // TextMeasure::glyph
+
+// ----------------------------------------------------------------------
+
+double TextMeasure::kerning(acmacs::surface::Surface& aSurface, Face& aFace, char aFirst, char aSecond, Scaled aSize)
+{
+    if (const auto found = aFace.kerning.find({aFirst, aSecond}); found != aFace.kerning.end())
+        return found->second;
+    const char pair[] = {aFirst, aSecond};
+    const auto kerning = measure_cairo(aSurface, aFace.style, std::string_view(pair, 2), aSize).width - glyph(aSurface, aFace, aFirst, aSize).width - glyph(aSurface, aFace, aSecond, aSize).width;
+    aFace.kerning.emplace(std::pair{aFirst, aSecond}, kerning);
+    return kerning;
+
+} // TextMeasure::kerning
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
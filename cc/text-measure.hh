@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include "acmacs-draw/surface.hh"
+
+// ----------------------------------------------------------------------
+
+// Text size measurement cache shared by all surfaces.
+// For each text style a table of glyph advances and kerning pairs is measured through cairo (surface text_size) on demand,
+// the width of a string is the sum of advances and kerning corrections of its characters.
+// Sizes are kept per unit of font size, text width is linear in font size.
+// Results for whole strings are kept in LRU.
+class TextMeasure
+{
+ public:
+    static TextMeasure& get();
+
+    acmacs::Size text_size(acmacs::surface::Surface& aSurface, std::string_view aText, Scaled aSize, const acmacs::TextStyle& aStyle, double* x_bearing = nullptr);
+    acmacs::Size text_size(acmacs::surface::Surface& aSurface, std::string_view aText, Pixels aSize, const acmacs::TextStyle& aStyle, double* x_bearing = nullptr)
+    {
+        return text_size(aSurface, aText, aSurface.convert(aSize), aStyle, x_bearing);
+    }
+
+    // compare every measurement with cairo and report differences bigger than tolerance (in fraction of font size)
+    void validate(bool aValidate, double aTolerance = 0.01) { mValidate = aValidate; mValidateTolerance = aTolerance; }
+    void report() const;
+
+ private:
+    struct Measured // per unit of font size
+    {
+        double width = -1; // -1: not yet measured
+        double height = 0;
+        double x_bearing = 0;
+    };
+
+    struct Face
+    {
+        Face(const acmacs::TextStyle& aStyle) : style(aStyle) {}
+
+        acmacs::TextStyle style;
+        std::array<Measured, 128> glyphs;
+        std::map<std::pair<char, char>, double> kerning;
+    };
+
+    using lru_key_t = std::pair<size_t, std::string>; // face index, text
+    using lru_t = std::list<std::pair<lru_key_t, Measured>>;
+
+    static constexpr const size_t LRUCapacity = 10000;
+
+    mutable std::mutex mAccess;
+    std::vector<Face> mFaces;
+    lru_t mLRU;
+    std::map<lru_key_t, lru_t::iterator> mLRUIndex;
+    bool mValidate = false;
+    double mValidateTolerance = 0.01;
+    size_t mHits = 0, mMisses = 0, mCairoCalls = 0, mValidationFailures = 0;
+
+    TextMeasure() = default;
+
+    size_t face_index(const acmacs::TextStyle& aStyle);
+    Measured measure(acmacs::surface::Surface& aSurface, Face& aFace, std::string_view aText, Scaled aSize);
+    Measured measure_cairo(acmacs::surface::Surface& aSurface, const acmacs::TextStyle& aStyle, std::string_view aText, Scaled aSize);
+    const Measured& glyph(acmacs::surface::Surface& aSurface, Face& aFace, char aGlyph, Scaled aSize);
+    double kerning(acmacs::surface::Surface& aSurface, Face& aFace, char aFirst, char aSecond, Scaled aSize);
+
+}; // class TextMeasure
+
+// ----------------------------------------------------------------------
+
+// Measure text through TextMeasure, drop-in replacement for aSurface.text_size()
+template <typename S> inline acmacs::Size measure_text(acmacs::surface::Surface& aSurface, std::string_view aText, S aSize, const acmacs::TextStyle& aStyle = acmacs::TextStyle{}, double* x_bearing = nullptr)
+{
+    return TextMeasure::get().text_size(aSurface, aText, aSize, aStyle, x_bearing);
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
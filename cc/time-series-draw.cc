@@ -1,8 +1,11 @@
+#include <map>
+
 #include "acmacs-base/log.hh"
 #include "signature-page/time-series-draw.hh"
 #include "signature-page/tree.hh"
 #include "signature-page/tree-draw.hh"
 #include "signature-page/coloring.hh"
+#include "signature-page/text-measure.hh"
 
 // ----------------------------------------------------------------------
 
@@ -68,6 +71,15 @@ void TimeSeriesDraw::init_settings(const SettingsInitializer& /*settings_initili
 
 // ----------------------------------------------------------------------
 
+void TimeSeriesDraw::prepare_draw()
+{
+    if (mNumberOfMonths)
+        collect_dashes(mSurface.viewport().size.width / static_cast<double>(mNumberOfMonths));
+
+} // TimeSeriesDraw::prepare_draw
+
+// ----------------------------------------------------------------------
+
 void TimeSeriesDraw::draw()
 {
     if (mNumberOfMonths) {
@@ -75,7 +87,7 @@ void TimeSeriesDraw::draw()
         const double month_width = mSurface.viewport().size.width / static_cast<double>(mNumberOfMonths);
         draw_labels(month_width);
         draw_month_separators(month_width);
-        draw_dashes(month_width);
+        mDashes.flush();
         draw_hz_section_lines();
     }
 
@@ -86,9 +98,9 @@ void TimeSeriesDraw::draw()
 void TimeSeriesDraw::draw_labels(double month_width)
 {
     const acmacs::Size& surface_size = mSurface.viewport().size;
-    const double month_max_height = mSurface.text_size("May ", Pixels{*mSettings.label_size}, mSettings.label_style).width;
+    const double month_max_height = measure_text(mSurface, "May ", Pixels{*mSettings.label_size}, mSettings.label_style).width;
     double x_bearing;
-    const auto big_label_size = mSurface.text_size("May 99", Pixels{*mSettings.label_size}, mSettings.label_style, &x_bearing);
+    const auto big_label_size = measure_text(mSurface, "May 99", Pixels{*mSettings.label_size}, mSettings.label_style, &x_bearing);
     const auto text_up = (month_width - big_label_size.height) * 0.5;
     const double month_year_to_timeseries_gap = mSurface.convert(Pixels{*mSettings.month_year_to_timeseries_gap}).value();
 
@@ -149,25 +161,24 @@ void TimeSeriesDraw::draw_month_separators(double month_width)
 
 // ----------------------------------------------------------------------
 
-void TimeSeriesDraw::draw_dashes(double month_width)
+void TimeSeriesDraw::collect_dashes(double month_width)
 {
-    const double base_x = month_width * (1.0 - mSettings.dash_width) / 2;
+    const double dash_width = month_width * mSettings.dash_width, base_x = (month_width - dash_width) / 2;
+    const Pixels dash_line_pixels{*mSettings.dash_line_width};
     const Coloring& coloring = mTreeDraw.coloring();
 
-    const auto begin{date::from_string(*mSettings.begin)}, end{date::from_string(*mSettings.end)};
+    const auto begin = LeafDate::parse(*mSettings.begin), end = LeafDate::parse(*mSettings.end);
+    std::map<std::pair<const Node*, int>, ColorCounter> collapsed; // leaves of subtrees collapsed into wedges: (wedge, month_no) -> colors
     auto draw_dash = [&](const Node& aNode) {
-        if (aNode.draw.shown && !aNode.data.date().empty()) {
-            if (const auto node_date_s = aNode.data.date(); node_date_s.size() > 3 && node_date_s.substr(node_date_s.size() - 3) != "-00") { // ignore incomplete dates
-                try {
-                    if (const auto node_date{date::from_string(node_date_s)}; node_date >= begin && node_date <= end) {
-                        const int month_no = date::months_between_dates(begin, node_date);
-                        const acmacs::PointCoordinates a(base_x + month_width * month_no, aNode.draw.vertical_pos);
-                        mSurface.line(a, {a.x() + month_width * mSettings.dash_width, a.y()}, coloring.color(aNode), Pixels{*mSettings.dash_line_width}, acmacs::surface::LineCap::Round);
-                    }
+        if (const auto& node_date = aNode.data.packed_date; aNode.draw.shown && node_date.known() && !node_date.partial) { // ignore incomplete dates
+            if (node_date.days >= begin.days && node_date.days <= end.days) {
+                const int month_no = node_date.month - begin.month;
+                if (aNode.draw.collapsed_into) {
+                    collapsed[{aNode.draw.collapsed_into, month_no}].add(coloring.color(aNode));
                 }
-                catch (std::exception& err) {
-                    if (aNode.data.date().size() > 4)
-                        std::cerr << "WARNING: " << err.what() << " (TimeSeriesDraw::draw_dashes) Date: " << aNode.data.date() << "\n";
+                else {
+                    const acmacs::PointCoordinates a(base_x + month_width * month_no, aNode.draw.vertical_pos);
+                    mDashes.line(a, {a.x() + dash_width, a.y()}, coloring.color(aNode), dash_line_pixels, acmacs::surface::LineCap::Round);
                 }
             }
         }
@@ -177,10 +188,19 @@ void TimeSeriesDraw::draw_dashes(double month_width)
         tree::iterate_leaf(mTree, draw_dash);
     }
     catch (std::exception& err) {
-        std::cerr << "WARNING: " << err.what() << " (TimeSeriesDraw::draw_dashes)\n";
+        std::cerr << "WARNING: " << err.what() << " (TimeSeriesDraw::collect_dashes)\n";
+    }
+
+      // one dash per wedge and month, dash gets thicker with the number of leaves up to the wedge height
+    const double dash_line_width = mSurface.convert(dash_line_pixels).value();
+    for (const auto& [wedge_month, colors] : collapsed) {
+        const auto [wedge, month_no] = wedge_month;
+        const double wedge_height = wedge->draw.collapsed->bottom - wedge->draw.collapsed->top;
+        const acmacs::PointCoordinates a(base_x + month_width * month_no, wedge->draw.vertical_pos);
+        mDashes.line(a, {a.x() + dash_width, a.y()}, colors.dominant(), Scaled{std::min(dash_line_width * static_cast<double>(colors.count()), std::max(wedge_height, dash_line_width))});
     }
 
-} // TimeSeriesDraw::draw_dashes
+} // TimeSeriesDraw::collect_dashes
 
 // ----------------------------------------------------------------------
 
@@ -214,7 +234,7 @@ void TimeSeriesDraw::draw_hz_section_label(size_t aSectionIndex, double aY)
     const auto section_settings = mHzSections.sections[aSectionIndex];
     if (section_settings->show && section_settings->show_map) {
         std::string label = mHzSections.node_refs[aSectionIndex].index; // (1, 'A' + static_cast<char>(aSectionNo));
-        const acmacs::Size tsize = mSurface.text_size(label, Pixels{*mHzSections.ts_label_size}, mHzSections.ts_label_style);
+        const acmacs::Size tsize = measure_text(mSurface, label, Pixels{*mHzSections.ts_label_size}, mHzSections.ts_label_style);
         mSurface.text({mSurface.viewport().size.width - tsize.width * 1.2, aY + tsize.height * 1.2}, label, mHzSections.ts_label_color, Pixels{*mHzSections.ts_label_size}, mHzSections.ts_label_style);
     }
 
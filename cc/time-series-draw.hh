@@ -4,6 +4,7 @@
 
 #include "acmacs-base/settings-v1.hh"
 #include "acmacs-draw/surface.hh"
+#include "line-batch.hh"
 
 // ----------------------------------------------------------------------
 
@@ -40,9 +41,10 @@ class TimeSeriesDraw
 {
  public:
     TimeSeriesDraw(acmacs::surface::Surface& aSurface, Tree& aTree, const TreeDraw& aTreeDraw, HzSections& aHzSections, TimeSeriesDrawSettings& aSettings)
-        : mSurface(aSurface), mTree(aTree), mTreeDraw(aTreeDraw), mSettings(aSettings), mHzSections(aHzSections), mTreeMode(false) {}
+        : mSurface(aSurface), mTree(aTree), mTreeDraw(aTreeDraw), mSettings(aSettings), mHzSections(aHzSections), mTreeMode(false), mDashes(aSurface) {}
 
     void prepare();
+    void prepare_draw();
     void draw();
     void draw_color_scale(const std::map<std::string, Color, std::less<>>& aTrackedAntigenColorByMonth);
 
@@ -64,11 +66,12 @@ class TimeSeriesDraw
     HzSections& mHzSections;
     size_t mNumberOfMonths;
     bool mTreeMode;
+    LineBatch mDashes;          // collected by prepare_draw()
 
     void draw_labels(double month_width);
     void draw_labels_at_side(const acmacs::PointCoordinates& aOrigin, double month_width, double month_max_height);
     void draw_month_separators(double month_width);
-    void draw_dashes(double month_width);
+    void collect_dashes(double month_width);
     void draw_hz_section_lines();
     void draw_hz_section_label(size_t aSectionIndex, double aY);
 
@@ -5,6 +5,7 @@
 #include "acmacs-chart-2/factory-import.hh"
 #include "signature-page/tree.hh"
 #include "signature-page/tree-export.hh"
+#include "signature-page/chart-cache.hh"
 
 // ----------------------------------------------------------------------
 
@@ -54,6 +55,7 @@ struct Options : public argv
     Options(int a_argc, const char* const a_argv[], on_error on_err = on_error::exit) : argv() { parse(a_argc, a_argv, on_err); }
 
     option<str> seqdb{*this, "seqdb"};
+    option<str> chart_cache{*this, "chart-cache", desc{"directory to keep uncompressed snapshots of charts in"}};
 
     option<size_t>    group_threshold{*this, "group-threshold", dflt{10UL}, desc{"minimum nuber of antigens in the group"}};
     option<str>       group_series_sets{*this, "group-series-sets", desc{"write group-series-set-v1 json"}};
@@ -70,9 +72,10 @@ int main(int argc, const char* argv[])
     try {
         Options opt(argc, argv);
 
-        acmacs::seqdb::setup(opt.seqdb);
+        tree::seqdb_setup(opt.seqdb);
+        chart_cache::setup(opt.chart_cache);
 
-        std::shared_ptr<acmacs::chart::Chart> chart = acmacs::chart::import_from_file(opt.chart);
+        std::shared_ptr<acmacs::chart::Chart> chart = chart_cache::import(opt.chart);
         Tree tree = tree::tree_import(opt.tree_file, chart);
 
         if (opt.group_series_sets) {
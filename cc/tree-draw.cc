@@ -1,7 +1,6 @@
 #include <fstream>
 #include <algorithm>
 #include <iomanip>
-#include <random>
 
 #include "acmacs-base/timeit.hh"
 #include "acmacs-base/range.hh"
@@ -12,11 +11,12 @@
 #include "signature-page/coloring.hh"
 #include "signature-page/settings-initializer.hh"
 #include "signature-page/signature-page.hh"
+#include "signature-page/text-measure.hh"
 
 // ----------------------------------------------------------------------
 
 TreeDraw::TreeDraw(SignaturePageDraw& aSignaturePageDraw, acmacs::surface::Surface& aSurface, Tree& aTree, TreeDrawSettings& aSettings, HzSections& aHzSections)
-    : mSignaturePageDraw(aSignaturePageDraw), mSurface(aSurface), mTree(aTree), mSettings(aSettings), mHzSections(aHzSections)
+    : mSignaturePageDraw(aSignaturePageDraw), mSurface(aSurface), mTree(aTree), mSettings(aSettings), mHzSections(aHzSections), mLines(aSurface)
 {
     make_coloring();
 }
@@ -75,19 +75,31 @@ void TreeDraw::detect_hz_lines_for_clades(const Clades* aClades, bool aForce)
 
 // ----------------------------------------------------------------------
 
-void TreeDraw::prepare()
+void TreeDraw::prepare_sections()
 {
     mTree.set_continents();
     ladderize();
     mTree.make_aa_transitions();
+    mNumberOfHzSections = prepare_hz_sections();
+
+} // TreeDraw::prepare_sections
+
+// ----------------------------------------------------------------------
 
-    size_t number_of_hz_sections = prepare_hz_sections();
+void TreeDraw::prepare()
+{
+    if (!mNumberOfHzSections)
+        prepare_sections();
+
+    size_t number_of_hz_sections = *mNumberOfHzSections;
     if (number_of_hz_sections == 0 || !mHzSections.show)
         number_of_hz_sections = 1;
     const auto& canvas_size = mSurface.viewport().size;
     mHorizontalStep = (canvas_size.width - mSettings.right_padding) / mTree.width();
     mVerticalStep = (canvas_size.height - static_cast<double>(number_of_hz_sections - 1) * mHzSections.vertical_gap) / static_cast<double>(mTree.height() + 2); // +2 to add space at the top and bottom
     set_vertical_pos();
+    collapse_subtrees();
+    mColoring->prepare(mTree);
 
     // const auto [virus_type, lineage] = mTree.virus_type_lineage();
     // if (!virus_type.empty()) {
@@ -197,15 +209,51 @@ bool TreeDraw::apply_mods()
 
 // ----------------------------------------------------------------------
 
-void TreeDraw::draw()
+void TreeDraw::prepare_draw()
 {
-    fmt::print("Tree surface: {}\n", mSurface.viewport());
     const double line_width = mSettings.line_width;
     mLineWidth = Scaled{mSettings.force_line_width ? line_width : std::min(line_width, mVerticalStep * 0.5)};
+    compile_settings();
     fit_labels_into_viewport();
+    if (mPreviewPixel > 0.0) {
+        const double font_pixels = mFontSize.value() / mSurface.convert(Pixels{1}).value();
+        mDrawLeafLabels = font_pixels >= mPreviewPixel * 4; // less than 4 device pixels is not legible
+    }
+
+} // TreeDraw::prepare_draw
+
+// ----------------------------------------------------------------------
+
+void TreeDraw::compile_settings()
+{
+    const auto& aa_transition = *mSettings.aa_transition;
+    mCompiled.line_color = mSettings.line_color;
+    mCompiled.label_style = mSettings.label_style;
+    mCompiled.aa_transition_show = aa_transition.show;
+    mCompiled.aa_transition_number_strains_threshold = aa_transition.number_strains_threshold;
+    mCompiled.aa_transition_show_empty_left = aa_transition.show_empty_left;
+    mCompiled.show_node_for_left_line = aa_transition.show_node_for_left_line;
+    mCompiled.node_for_left_line_color = aa_transition.node_for_left_line_color;
+    mCompiled.node_for_left_line_width = aa_transition.node_for_left_line_width;
+    mCompiled.aa_transition_per_branch.emplace(*aa_transition.per_branch);
+
+} // TreeDraw::compile_settings
+
+// ----------------------------------------------------------------------
+
+void TreeDraw::draw()
+{
+    fmt::print("Tree surface: {}\n", mSurface.viewport());
+
+    if (const auto search_range = mCompiled.aa_transition_per_branch->label_offset_search_range(); mCompiled.aa_transition_show && search_range > 0.0) {
+        mLabelPlacement.emplace(mSurface.viewport().size, mSurface.convert(Pixels{search_range}).value());
+        add_label_obstacles(mTree, 0, mSettings.root_edge);
+    }
 
     double vertical_gap = 0;
     draw_node(mTree, 0 /*mLineWidth / 2*/, vertical_gap, mSettings.root_edge);
+    mLines.flush();
+    draw_labels();              // after edges, labels must not be covered by lines
     report_aa_transitions();
     mColoring->report();
     draw_legend();
@@ -216,6 +264,16 @@ void TreeDraw::draw()
 
 // ----------------------------------------------------------------------
 
+void TreeDraw::draw_labels()
+{
+    for (const auto& label : mLabels)
+        mSurface.text(label.origin, label.text, label.color, label.size, label.style);
+    mLabels.clear();
+
+} // TreeDraw::draw_labels
+
+// ----------------------------------------------------------------------
+
 // void TreeDraw::unhide()
 // {
 //     auto show_leaf = [](Node& aNode) {
@@ -230,8 +288,8 @@ void TreeDraw::draw()
 
 void TreeDraw::hide_isolated_before(std::string_view aDate)
 {
-    auto hide_show_leaf = [aDate](Node& aNode) {
-        aNode.draw.shown &= aNode.data.date() >= aDate;
+    auto hide_show_leaf = [first_day = LeafDate::parse(aDate).days](Node& aNode) {
+        aNode.draw.shown &= aNode.data.packed_date.days >= first_day;
     };
 
     tree::iterate_leaf_post(mTree, hide_show_leaf, hide_branch);
@@ -254,8 +312,8 @@ void TreeDraw::hide_if_cumulative_edge_length_bigger_than(double aThreshold)
 
 void TreeDraw::hide_before2015_58P_or_146I_or_559I()
 {
-    auto hide_show_leaf = [](Node& aNode) {
-        if (aNode.data.has_sequence() && aNode.data.date() < "2015-01-01") {
+    auto hide_show_leaf = [first_day_2015 = LeafDate::parse("2015-01-01").days](Node& aNode) {
+        if (aNode.data.has_sequence() && aNode.data.packed_date.days < first_day_2015) {
             const auto aa = aNode.data.amino_acids();
             if (aa[57] == 'P' || aa[145] == 'I' || aa[559] == 'I')
                 aNode.draw.shown = false;
@@ -445,8 +503,9 @@ void TreeDraw::mark_clade_with_line(std::string_view aClade, Color aColor, Pixel
 {
     size_t marked = 0;
     bool reported = false;
-    auto mark_leaf = [aClade,&aColor,&aLineWidth,&marked,&reported,aReport,leaf_no=0](Node& aNode) mutable {
-        if (aNode.data.has_clade(aClade)) {
+    const auto clade_id = mTree.clades.find(aClade);
+    auto mark_leaf = [clade_id,&aColor,&aLineWidth,&marked,&reported,aReport,leaf_no=0](Node& aNode) mutable {
+        if (aNode.data.has_clade(clade_id)) {
             aNode.draw.mark_with_line = aColor;
             aNode.draw.mark_with_line_width = aLineWidth;
             ++marked;
@@ -463,9 +522,12 @@ void TreeDraw::mark_clade_with_line(std::string_view aClade, Color aColor, Pixel
         ++leaf_no;
     };
 
-    if (aReport)
+    if (aReport) {
         std::cout << aClade << '\n';
-    tree::iterate_leaf(mTree, mark_leaf);
+        tree::iterate_leaf(mTree, mark_leaf);
+    }
+    else if (clade_id != Categories::NoId) // leaf_no is used for reporting only, skip subtrees having no clade
+        tree::iterate_leaf_pre_stop(mTree, mark_leaf, [clade_id](const Node& aNode) { return aNode.data.has_clade(clade_id); });
     if (marked == 0)
         std::cerr << "WARNING: no nodes found to mark with line for clade: " << aClade << '\n';
     else
@@ -479,8 +541,9 @@ void TreeDraw::mark_country_with_line(std::string_view aCountry, Color aColor, P
 {
     size_t marked = 0;
     bool reported = false;
-    auto mark_leaf = [aCountry,&aColor,&aLineWidth,&marked,&reported,aReport,leaf_no=0](Node& aNode) mutable {
-        if (aNode.data.country() == aCountry) {
+    const auto country_id = mTree.countries.find(aCountry);
+    auto mark_leaf = [country_id,&aColor,&aLineWidth,&marked,&reported,aReport,leaf_no=0](Node& aNode) mutable {
+        if (aNode.data.country_id == country_id) {
             aNode.draw.mark_with_line = aColor;
             aNode.draw.mark_with_line_width = aLineWidth;
             ++marked;
@@ -499,7 +562,8 @@ void TreeDraw::mark_country_with_line(std::string_view aCountry, Color aColor, P
 
     if (aReport)
         std::cout << aCountry << '\n';
-    tree::iterate_leaf(mTree, mark_leaf);
+    if (country_id != Categories::NoId)
+        tree::iterate_leaf(mTree, mark_leaf);
     if (marked == 0)
         std::cerr << "WARNING: no nodes found to mark with line for country: " << aCountry << '\n';
     else
@@ -514,8 +578,9 @@ void TreeDraw::mark_location_with_line(std::string_view aLocation, Color aColor,
 {
     size_t marked = 0;
     bool reported = false;
-    auto mark_leaf = [aLocation,&aColor,&aLineWidth,&marked,&reported,aReport,leaf_no=0](Node& aNode) mutable {
-        if (aNode.data.location() == aLocation) {
+    const auto location_id = mTree.locations.find(aLocation);
+    auto mark_leaf = [location_id,&aColor,&aLineWidth,&marked,&reported,aReport,leaf_no=0](Node& aNode) mutable {
+        if (aNode.data.location_id == location_id) {
             aNode.draw.mark_with_line = aColor;
             aNode.draw.mark_with_line_width = aLineWidth;
             ++marked;
@@ -534,7 +599,8 @@ void TreeDraw::mark_location_with_line(std::string_view aLocation, Color aColor,
 
     if (aReport)
         std::cout << aLocation << '\n';
-    tree::iterate_leaf(mTree, mark_leaf);
+    if (location_id != Categories::NoId)
+        tree::iterate_leaf(mTree, mark_leaf);
     if (marked == 0)
         std::cerr << "WARNING: no nodes found to mark with line for location: " << aLocation << '\n';
     else
@@ -675,6 +741,73 @@ void TreeDraw::set_vertical_pos()
 
 // ----------------------------------------------------------------------
 
+// returns span of the shown leaves of aNode, marks aNode as collapsed if its span is below threshold
+static NodeDrawData::Collapsed find_collapsible(Node& aNode, double aThreshold, bool aKeepMarked, bool& aMarked)
+{
+    NodeDrawData::Collapsed span;
+    aNode.draw.collapsed.reset();
+    aNode.draw.collapsed_into = nullptr;
+    if (aNode.draw.shown) {
+        if (aNode.is_leaf()) {
+            span = NodeDrawData::Collapsed{1, aNode.draw.vertical_pos, aNode.draw.vertical_pos, 0.0};
+            aMarked |= aKeepMarked && (!aNode.draw.mark_with_line.is_no_change() || aNode.draw.mark_with_label.has_value());
+        }
+        else {
+            bool marked = false;
+            for (auto& node : aNode.subtree) {
+                if (const auto sub = find_collapsible(node, aThreshold, aKeepMarked, marked); sub.leaves > 0) {
+                    if (span.leaves == 0)
+                        span.top = sub.top;
+                    span.bottom = sub.bottom;
+                    span.leaves += sub.leaves;
+                    span.depth = std::max(span.depth, node.edge_length + sub.depth);
+                }
+            }
+            if (!marked && span.leaves > 1 && (span.bottom - span.top) < aThreshold)
+                aNode.draw.collapsed = span;
+            aMarked |= marked;
+        }
+    }
+    return span;
+
+} // find_collapsible
+
+// ----------------------------------------------------------------------
+
+void TreeDraw::collapse_subtrees()
+{
+    const double threshold_pixels = std::max(*mSettings.collapse_threshold, mPreviewPixel * 2); // in preview subtrees of less than 2 device pixels are always collapsed
+    const double threshold = mSurface.convert(Pixels{threshold_pixels}).value();
+    bool marked = false;
+    find_collapsible(mTree, threshold, mSettings.collapse_keep_marked, marked);
+    if (threshold_pixels <= 0.0)
+        return;
+
+      // only outermost collapsed subtrees are drawn as wedges
+    size_t wedges = 0, collapsed_leaves = 0;
+    auto collapse = [&](Node& aNode) -> bool {
+        if (!aNode.draw.collapsed)
+            return true;
+        ++wedges;
+        collapsed_leaves += aNode.draw.collapsed->leaves;
+        const Node* collapsed_into = &aNode;
+        tree::iterate_leaf_pre(aNode, [collapsed_into](Node& aLeaf) { aLeaf.draw.collapsed_into = collapsed_into; },
+                               [collapsed_into](Node& aSubtree) {
+                                   if (&aSubtree != collapsed_into) {
+                                       aSubtree.draw.collapsed.reset();
+                                       aSubtree.draw.collapsed_into = collapsed_into;
+                                   }
+                               });
+        return false;
+    };
+    tree::iterate_leaf_pre_stop(mTree, [](Node&) {}, collapse);
+    if (wedges)
+        fmt::print("INFO: tree: {} leaves collapsed into {} wedges, threshold: {}px\n", collapsed_leaves, wedges, threshold_pixels);
+
+} // TreeDraw::collapse_subtrees
+
+// ----------------------------------------------------------------------
+
 size_t TreeDraw::prepare_hz_sections()
 {
     mHzSections.convert_aa_transitions(mTree); // to name based hz sections
@@ -685,7 +818,7 @@ size_t TreeDraw::prepare_hz_sections()
     for (auto section_index: mHzSections.section_order) {
         const auto section = mHzSections.sections[section_index];
         if (section->show) {
-            Node* section_start = mTree.find_leaf_by_seqid(section->name);
+            const Node* section_start = mHzSections.node_refs[section_index].first; // set by sort()
             if (section_start) {
                 if (section_start->draw.shown) {
                     section_start->draw.hz_section_index = section_index;
@@ -712,7 +845,7 @@ size_t TreeDraw::prepare_hz_sections()
 
 void TreeDraw::calculate_name_offset()
 {
-    const auto tsize = mSurface.text_size("W", mFontSize, mSettings.label_style);
+    const auto tsize = measure_text(mSurface, "W", mFontSize, mSettings.label_style);
     mNameOffset = mSettings.name_offset * tsize.width;
 
 } // TreeDraw::calculate_name_offset
@@ -722,36 +855,51 @@ void TreeDraw::calculate_name_offset()
 void TreeDraw::fit_labels_into_viewport()
 {
     mFontSize = Scaled{mVerticalStep};
+    measure_labels();
+    calculate_name_offset();
 
     const double canvas_width = mSurface.viewport().size.width;
     fmt::print("INFO: viewport: {}\n", mSurface.viewport());
 
-    // Timeit ti("DEBUG: TreeDraw::fit_labels_into_viewport: ");
-    for (double label_offset = max_label_offset(); label_offset > canvas_width; label_offset = max_label_offset()) {
-        const double scale = std::min(canvas_width / label_offset, 0.99); // to avoid too much looping
+    // label right ends are linear in mHorizontalStep and mFontSize, scaling both by the same factor scales max_label_offset() by that factor
+    if (const double label_offset = max_label_offset(); label_offset > canvas_width) {
+        const double scale = std::min(canvas_width / label_offset, 0.99);
         fmt::print("INFO: canvas:{} label_right:{} scale:{}\n", canvas_width, label_offset, scale);
         mHorizontalStep *= scale;
         mFontSize *= scale;
+        calculate_name_offset();
     }
 
 } // TreeDraw::fit_labels_into_viewport
 
 // ----------------------------------------------------------------------
 
-double TreeDraw::max_label_offset()
+void TreeDraw::measure_labels()
 {
-    calculate_name_offset();
-
-    double max_label_origin = 0, max_label_right = 0;
-    auto label_offset = [&](Node& node) {
+    const double font_size = mFontSize.value();
+    auto measure = [this, font_size](const Node& node) {
         if (node.draw.shown) {
-            const double label_origin = node.data.cumulative_edge_length * mHorizontalStep + mNameOffset;
-            max_label_origin = std::max(max_label_origin, label_origin);
-            max_label_right = std::max(max_label_right, label_origin + this->text_width(node.display_name()));
+            node.draw.label = node.display_name();
+            const auto size = measure_text(mSurface, node.draw.label, mFontSize, mSettings.label_style);
+            node.draw.label_width = size.width / font_size;
+            node.draw.label_height = size.height / font_size;
         }
     };
+    tree::iterate_leaf(mTree, measure);
+
+} // TreeDraw::measure_labels
+
+// ----------------------------------------------------------------------
+
+double TreeDraw::max_label_offset() const
+{
+    const double font_size = mFontSize.value();
+    double max_label_right = 0;
+    auto label_offset = [&](const Node& node) {
+        if (node.draw.shown)
+            max_label_right = std::max(max_label_right, node.data.cumulative_edge_length * mHorizontalStep + mNameOffset + node.draw.label_width * font_size);
+    };
 
-    // Timeit ti("TreeDraw::max_label_offset: ");
     tree::iterate_leaf(mTree, label_offset);
     return max_label_right;
 
@@ -766,19 +914,22 @@ void TreeDraw::draw_node(const Node& aNode, double aOriginX, double& aVerticalGa
         const double right = aOriginX + size.width;
 
         if (aNode.is_leaf()) {
-            const std::string text = aNode.display_name();
-            const auto tsize = mSurface.text_size(text, mFontSize, mSettings.label_style);
-            const acmacs::PointCoordinates text_origin(right + mNameOffset, aNode.draw.vertical_pos + tsize.height / 2);
-            mSurface.text(text_origin, text, mColoring->color(aNode), mFontSize, mSettings.label_style);
+            const std::string& text = aNode.draw.label; // see measure_labels()
+            const acmacs::PointCoordinates text_origin(right + mNameOffset, aNode.draw.vertical_pos + aNode.draw.label_height * mFontSize.value() / 2);
+            if (mDrawLeafLabels)
+                add_label(text_origin, text, mColoring->color(aNode), mFontSize, mCompiled.label_style);
             if (text_origin.x() < 0 || text_origin.y() < 0)
                 fmt::print(stderr, "WARNING: bad origin for a node label: {} \"{}\" mNameOffset:{} aOriginX:{}\n", text_origin, text, mNameOffset, aOriginX);
 
             if (!aNode.draw.mark_with_line.is_no_change()) {
                 // mSurface.line({text_origin.x() + tsize.width, text_origin.y}, {mSurface.viewport().size.width, text_origin.y}, aNode.draw.mark_with_line, aNode.draw.mark_with_line_width);
-                mSurface.line({mSurface.viewport().size.width - 10, text_origin.y()}, {mSurface.viewport().size.width, text_origin.y()}, aNode.draw.mark_with_line, aNode.draw.mark_with_line_width);
+                mLines.line({mSurface.viewport().size.width - 10, text_origin.y()}, {mSurface.viewport().size.width, text_origin.y()}, aNode.draw.mark_with_line, aNode.draw.mark_with_line_width);
             }
             draw_mark_with_label(aNode, text_origin);
         }
+        else if (aNode.draw.collapsed) {
+            draw_collapsed(aNode, right);
+        }
         else {
             double top = -1, bottom = -1;
             for (auto& node: aNode.subtree) {
@@ -790,9 +941,9 @@ void TreeDraw::draw_node(const Node& aNode, double aOriginX, double& aVerticalGa
                         bottom = node.draw.vertical_pos;
                 }
             }
-            mSurface.line({right, top}, {right, bottom}, mSettings.line_color, mLineWidth, acmacs::surface::LineCap::Square);
+            mLines.line({right, top}, {right, bottom}, mCompiled.line_color, mLineWidth, acmacs::surface::LineCap::Square);
         }
-        mSurface.line({aOriginX, aNode.draw.vertical_pos}, {right, aNode.draw.vertical_pos}, mSettings.line_color, mLineWidth);
+        mLines.line({aOriginX, aNode.draw.vertical_pos}, {right, aNode.draw.vertical_pos}, mCompiled.line_color, mLineWidth);
         draw_aa_transition(aNode, {aOriginX, aNode.draw.vertical_pos}, right);
     }
 
@@ -800,15 +951,72 @@ void TreeDraw::draw_node(const Node& aNode, double aOriginX, double& aVerticalGa
 
 // ----------------------------------------------------------------------
 
+void TreeDraw::draw_collapsed(const Node& aNode, double aLeft)
+{
+    const auto& collapsed = *aNode.draw.collapsed;
+    ColorCounter colors;
+    tree::iterate_leaf(aNode, [&colors,this](const Node& aLeaf) {
+        if (aLeaf.draw.shown)
+            colors.add(mColoring->color(aLeaf));
+    });
+    const Color color = colors.dominant();
+
+    const double right = aLeft + collapsed.depth * mHorizontalStep;
+    const double wedge[] = {-std::max(aLeft, std::numeric_limits<double>::min()), aNode.draw.vertical_pos, right, collapsed.top, right, collapsed.bottom};
+    mSurface.path_fill_negative_move(std::begin(wedge), std::end(wedge), color);
+
+    const auto text = fmt::format("{} sequences", collapsed.leaves);
+    const auto tsize = measure_text(mSurface, text, mFontSize, mCompiled.label_style);
+    add_label({right + mNameOffset, aNode.draw.vertical_pos + tsize.height / 2}, text, color, mFontSize, mCompiled.label_style);
+
+} // TreeDraw::draw_collapsed
+
+// ----------------------------------------------------------------------
+
+// tree edges, wedges and hz section gaps as soft obstacles for aa transition label placement, geometry follows draw_node()
+void TreeDraw::add_label_obstacles(const Node& aNode, double aOriginX, double aEdgeLength)
+{
+    if (aNode.draw.shown) {
+        const double line_width = mLineWidth.value();
+        const double right = aOriginX + (aEdgeLength < 0.0 ? aNode.edge_length : aEdgeLength) * mHorizontalStep;
+        if (aNode.is_leaf()) {
+            if (aNode.draw.hz_section_index != NodeDrawData::HzSectionNoIndex && mHzSections.show && mHzSections.sections[aNode.draw.hz_section_index]->show) {
+                const double gap_middle = aNode.draw.vertical_pos - (mVerticalStep + mHzSections.vertical_gap) / 2;
+                mLabelPlacement->add_line({0, gap_middle}, {mSurface.viewport().size.width, gap_middle}, line_width);
+            }
+        }
+        else if (aNode.draw.collapsed) {
+            const auto& collapsed = *aNode.draw.collapsed;
+            mLabelPlacement->add({right, collapsed.top, right + collapsed.depth * mHorizontalStep, collapsed.bottom}, LabelPlacement::Obstacle::Soft);
+        }
+        else {
+            double top = -1, bottom = -1;
+            for (auto& node : aNode.subtree) {
+                if (node.draw.shown) {
+                    add_label_obstacles(node, right);
+                    if (top < 0)
+                        top = node.draw.vertical_pos;
+                    bottom = std::max(bottom, node.draw.vertical_pos);
+                }
+            }
+            mLabelPlacement->add_line({right, top}, {right, bottom}, line_width);
+        }
+        mLabelPlacement->add_line({aOriginX, aNode.draw.vertical_pos}, {right, aNode.draw.vertical_pos}, line_width);
+    }
+
+} // TreeDraw::add_label_obstacles
+
+// ----------------------------------------------------------------------
+
 void TreeDraw::draw_aa_transition(const Node& aNode, const acmacs::PointCoordinates& aOrigin, double aRight)
 {
     auto& settings = mSettings.aa_transition;
     const auto& first_leaf = find_first_leaf(aNode);
-    if (settings->show && !aNode.data.aa_transitions.empty() && aNode.data.number_strains >= settings->number_strains_threshold) {
-        if (auto labels = aNode.data.aa_transitions.make_labels(settings->show_empty_left); !labels.empty()) {
-            if (const auto /*not ref! */ branch_settings = settings->per_branch->settings_for_label(labels, first_leaf.seq_id); branch_settings.show) {
+    if (mCompiled.aa_transition_show && !aNode.data.aa_transitions.empty() && aNode.data.number_strains >= mCompiled.aa_transition_number_strains_threshold) {
+        if (auto labels = aNode.data.aa_transitions.make_labels(mCompiled.aa_transition_show_empty_left); !labels.empty()) {
+            if (const auto /*not ref! */ branch_settings = mCompiled.aa_transition_per_branch->settings_for_label(labels, first_leaf.seq_id); branch_settings.show) {
                 const auto longest_label = std::max_element(labels.begin(), labels.end(), [](const auto& a, const auto& b) { return a.first.size() < b.first.size(); });
-                const auto longest_label_size = mSurface.text_size(longest_label->first, Pixels{branch_settings.size}, branch_settings.style);
+                const auto longest_label_size = measure_text(mSurface, longest_label->first, Pixels{branch_settings.size}, branch_settings.style);
                 const auto node_line_width = aRight - aOrigin.x();
                 acmacs::Offset offset{node_line_width > longest_label_size.width ? (node_line_width - longest_label_size.width) / 2 : (node_line_width - longest_label_size.width),
                                       longest_label_size.height * branch_settings.interline};
@@ -816,6 +1024,11 @@ void TreeDraw::draw_aa_transition(const Node& aNode, const acmacs::PointCoordina
                 acmacs::PointCoordinates origin = aOrigin + offset;
                 if (branch_settings.label_absolute_x.has_value())
                     origin.x(*branch_settings.label_absolute_x);
+                if (mLabelPlacement) {
+                    const double labels_height = longest_label_size.height * (1.0 + branch_settings.interline * static_cast<double>(labels.size() - 1));
+                    const LabelPlacement::Box box{origin.x(), origin.y() - longest_label_size.height, origin.x() + longest_label_size.width, origin.y() - longest_label_size.height + labels_height};
+                    origin = origin + mLabelPlacement->place(box, mSurface.convert(Pixels{mCompiled.aa_transition_per_branch->label_offset_search_range()}).value(), longest_label_size.height);
+                }
                 acmacs::TextStyle label_style = branch_settings.style;
                 Color label_color = branch_settings.color;
 
@@ -823,20 +1036,20 @@ void TreeDraw::draw_aa_transition(const Node& aNode, const acmacs::PointCoordina
                 const auto section_label_matches = [](std::string section_label, const auto& labels_to_match) -> bool {
                     return std::any_of(std::begin(labels_to_match), std::end(labels_to_match), [&section_label](const auto& label) { return label.first == section_label; });
                 };
-                if (const auto section = mHzSections.find_section(find_first_leaf(aNode).seq_id); section && (*section)->show_map && section_label_matches((*section)->label, labels)) {
+                if (const auto section_no = mHzSections.section_index(first_leaf.seq_id); section_no && mHzSections.sections[*section_no]->show_map && section_label_matches(mHzSections.sections[*section_no]->label, labels)) {
                     label_style.weight = acmacs::FontWeight{acmacs::FontWeight::Bold};
                     // label_color = BLUE;
                 }
 
                 acmacs::Rectangle label_box(origin.x(), origin.y() - longest_label_size.height, origin.x() + longest_label_size.width, origin.y());
                 for (const auto& label: labels) {
-                    const auto label_width = mSurface.text_size(label.first, Pixels{branch_settings.size}, label_style).width;
+                    const auto label_width = measure_text(mSurface, label.first, Pixels{branch_settings.size}, label_style).width;
                     const acmacs::PointCoordinates label_xy(origin.x() + (longest_label_size.width - label_width) / 2, origin.y());
-                    mSurface.text(label_xy, label.first, label_color, Pixels{branch_settings.size}, label_style);
-                    if (settings->show_node_for_left_line && label.second) {
-                        mSurface.line(acmacs::PointCoordinates::zero2D,
+                    add_label(label_xy, label.first, label_color, mSurface.convert(Pixels{branch_settings.size}), label_style);
+                    if (mCompiled.show_node_for_left_line && label.second) {
+                        mLines.line(acmacs::PointCoordinates::zero2D,
                                       acmacs::PointCoordinates(mHorizontalStep * label.second->data.cumulative_edge_length, mVerticalStep * static_cast<double>(label.second->draw.line_no)),
-                                      settings->node_for_left_line_color, Pixels{*settings->node_for_left_line_width});
+                                      mCompiled.node_for_left_line_color, Pixels{mCompiled.node_for_left_line_width});
                     }
                     label_box.bottom_right.y(origin.y());
                     origin.y(origin.y() + longest_label_size.height * branch_settings.interline);
@@ -857,7 +1070,7 @@ void TreeDraw::draw_aa_transition(const Node& aNode, const acmacs::PointCoordina
                 }
 
                 if (distance(connection_line_start, connection_line_end) > 10)
-                    mSurface.line(connection_line_start, connection_line_end, branch_settings.label_connection_line_color, mLineWidth /*branch_settings.label_connection_line_width*/);
+                    mLines.line(connection_line_start, connection_line_end, branch_settings.label_connection_line_color, mLineWidth /*branch_settings.label_connection_line_width*/);
 
                 if (mInitializeSettings)
                     settings->per_branch->by_aa_label.append()->set_label_disabled_offset(labels.label(), first_leaf.seq_id, settings->per_branch->label_offset);
@@ -883,10 +1096,10 @@ void TreeDraw::draw_mark_with_label(const Node& aNode, const acmacs::PointCoordi
             acmacs::PointCoordinates label_origin = aTextOrigin + label_offset;
             if (settings->label_absolute_x.is_set_or_has_default())
                 label_origin.x(settings->label_absolute_x);
-            mSurface.text(label_origin, *settings->label, Color{*settings->label_color}, Pixels{*settings->label_size}, settings->label_style);
-            const auto vlsize = mSurface.text_size(*settings->label, Pixels{*settings->label_size}, acmacs::TextStyle{});
+            add_label(label_origin, *settings->label, Color{*settings->label_color}, mSurface.convert(Pixels{*settings->label_size}), settings->label_style);
+            const auto vlsize = measure_text(mSurface, *settings->label, Pixels{*settings->label_size}, acmacs::TextStyle{});
             const auto line_origin = label_origin + acmacs::Offset{vlsize.width / 2, label_offset.y() > 0 ? -vlsize.height : 0};
-            mSurface.line(line_origin, aTextOrigin, Color{*settings->line_color}, Pixels{*settings->line_width});
+            mLines.line(line_origin, aTextOrigin, Color{*settings->line_color}, Pixels{*settings->line_width});
             last_marked_with_label_ = std::tuple(aNode.draw.line_no, *settings->label);
         }
     }
@@ -1047,10 +1260,10 @@ void HzSections::convert_aa_transitions(Tree& tree) // to name based hz sections
     sections.for_each([&tree, &to_remove, &to_add](auto& section, size_t section_index) {
         if (!section.aa_transition.empty()) {
             // std::cerr << "DEBUG:   section " << section_index << ' ' << section.name << ' ' << section.aa_transition << '\n';
-            tree::iterate_pre(tree, [&to_add, &section](const Node& node) {
-                if (node.data.aa_transitions.contains(section.aa_transition) && node.data.number_strains > 200)
-                    to_add.emplace_back(&node, *section.aa_transition);
-            });
+            for (const Node* node : tree.nodes_with_aa_transition(*section.aa_transition)) {
+                if (node->data.number_strains > 200)
+                    to_add.emplace_back(node, *section.aa_transition);
+            }
             to_remove.push_back(section_index);
         }
     });
@@ -1072,8 +1285,9 @@ void HzSections::sort(const Tree& aTree)
 
     node_refs.resize(sections.size());
 
+    make_section_index();
     auto set_first_node = [this](const Node& node) {
-        if (auto sec_no = sections.find_index_if([&node](const auto& s) -> bool { return s.name == node.seq_id; }); sec_no)
+        if (auto sec_no = section_index(node.seq_id); sec_no)
             node_refs[*sec_no].first = &node;
     };
     tree::iterate_leaf(aTree, set_first_node);
@@ -1127,10 +1341,34 @@ void HzSections::sort(const Tree& aTree)
         }
     }
 
+    make_section_index();
+
 } // HzSections::sort
 
 // ----------------------------------------------------------------------
 
+void HzSections::make_section_index()
+{
+    mSectionIndex.clear();
+    sections.for_each([this](const HzSection& section, size_t section_no) {
+        if (!section.name.empty())
+            mSectionIndex.emplace(*section.name, section_no);
+    });
+
+} // HzSections::make_section_index
+
+// ----------------------------------------------------------------------
+
+std::optional<size_t> HzSections::section_index(std::string_view seq_id) const
+{
+    if (const auto found = mSectionIndex.find(std::string{seq_id}); found != mSectionIndex.end())
+        return found->second;
+    return std::nullopt;
+
+} // HzSections::section_index
+
+// ----------------------------------------------------------------------
+
 void HzSections::report(std::ostream& out) const
 {
     out << "INFO: hz sections " << section_order.size() << '\n';
@@ -1343,26 +1581,30 @@ void AATransitionIndividualSettingsForLabel::update(const AATransitionIndividual
 
 // ----------------------------------------------------------------------
 
-AATransitionIndividualSettingsForLabel AATransitionPerBranchDrawSettings::settings_for_label(const AA_TransitionLabels& aLabels, std::string_view aFirstLeafSeqid) const
+AATransitionPerBranchCompiled::AATransitionPerBranchCompiled(const AATransitionPerBranchDrawSettings& aSettings)
+    : mDefault(aSettings), mLabelOffsetSearchRange(aSettings.scatter_label_offset)
 {
-    AATransitionIndividualSettingsForLabel result(*this);
-    auto match_entry = [label = aLabels.label(), aFirstLeafSeqid](const AATransitionIndividualSettings& entry) {
-        return entry.label == label && (entry.first_leaf_seq_id == "" || entry.first_leaf_seq_id == std::string{aFirstLeafSeqid});
-    };
-    if (auto found = by_aa_label.find_if(match_entry); found) {
-        result.update(*found);
-    }
+    aSettings.by_aa_label.for_each([this](const AATransitionIndividualSettings& entry, size_t /*entry_no*/) {
+        AATransitionIndividualSettingsForLabel for_label(mDefault);
+        for_label.update(entry);
+        mByAALabel[*entry.label].emplace_back(*entry.first_leaf_seq_id, std::move(for_label));
+    });
+
+} // AATransitionPerBranchCompiled::AATransitionPerBranchCompiled
 
-    if (scatter_label_offset > 0.0) {
-        std::random_device rand;
-        constexpr const auto rand_size = static_cast<double>(rand.max() - rand.min());
-        const acmacs::PointCoordinates old_label_offset = result.label_offset;
-        result.label_offset.x(static_cast<double>(rand()) * scatter_label_offset * 2 / rand_size - scatter_label_offset + old_label_offset.x());
-        result.label_offset.y(static_cast<double>(rand()) * scatter_label_offset * 2 / rand_size - scatter_label_offset + old_label_offset.y());
+// ----------------------------------------------------------------------
+
+AATransitionIndividualSettingsForLabel AATransitionPerBranchCompiled::settings_for_label(const AA_TransitionLabels& aLabels, std::string_view aFirstLeafSeqid) const
+{
+    AATransitionIndividualSettingsForLabel result(mDefault);
+    if (const auto found = mByAALabel.find(aLabels.label()); found != mByAALabel.end()) {
+          // first entry either without first_leaf_seq_id or with the matching one
+        if (const auto entry = std::find_if(found->second.begin(), found->second.end(), [aFirstLeafSeqid](const auto& en) { return en.first.empty() || en.first == aFirstLeafSeqid; }); entry != found->second.end())
+            result = entry->second;
     }
     return result;
 
-} // AATransitionPerBranchDrawSettings::settings_for_label
+} // AATransitionPerBranchCompiled::settings_for_label
 
 // ----------------------------------------------------------------------
 /// Local Variables:
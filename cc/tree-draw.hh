@@ -7,9 +7,12 @@
 #include <algorithm>
 #include <optional>
 #include <tuple>
+#include <unordered_map>
 
 #include "acmacs-draw/surface.hh"
 #include "legend.hh"
+#include "line-batch.hh"
+#include "label-placement.hh"
 #include "clades-draw.hh"
 
 // ----------------------------------------------------------------------
@@ -92,13 +95,11 @@ class AATransitionPerBranchDrawSettings : public acmacs::settings::v1::object
     acmacs::settings::v1::field<double>                                  interline{this, "interline", 1.2};
     acmacs::settings::v1::field<acmacs::Offset>                          label_offset{this, "label_offset", {-40, 20}};
     acmacs::settings::v1::field<double>                                  scatter_label_offset{this, "scatter_label_offset", 0.0};
-    acmacs::settings::v1::field<std::string>                             scatter_label_offset_help{this, "scatter_label_offset?", "randomization range for label offset in trying to avoid clattering (mostly for figuring out good offsets"};
+    acmacs::settings::v1::field<std::string>                             scatter_label_offset_help{this, "scatter_label_offset?", "range (pixels) to search for label offset avoiding overlapping with other labels and tree lines, 0 - use label_offset as is"};
     acmacs::settings::v1::field<double>                                  label_connection_line_width{this, "label_connection_line_width", 0.1};
     acmacs::settings::v1::field<Color>                                   label_connection_line_color{this, "label_connection_line_color", "black"};
     acmacs::settings::v1::field_array_of<AATransitionIndividualSettings> by_aa_label{this, "by_aa_label"};
 
-    AATransitionIndividualSettingsForLabel settings_for_label(const AA_TransitionLabels& aLabels, std::string_view aFirstLeafSeqid) const;
-
     void remove_for_tree_settings();
     void remove_for_signature_page_settings();
 
@@ -106,6 +107,24 @@ class AATransitionPerBranchDrawSettings : public acmacs::settings::v1::object
 
 // ----------------------------------------------------------------------
 
+// Typed snapshot of AATransitionPerBranchDrawSettings made before drawing, by_aa_label entries are hashed by label
+class AATransitionPerBranchCompiled
+{
+ public:
+    AATransitionPerBranchCompiled(const AATransitionPerBranchDrawSettings& aSettings);
+
+    AATransitionIndividualSettingsForLabel settings_for_label(const AA_TransitionLabels& aLabels, std::string_view aFirstLeafSeqid) const;
+    double label_offset_search_range() const { return mLabelOffsetSearchRange; } // pixels
+
+ private:
+    AATransitionIndividualSettingsForLabel mDefault;
+    double mLabelOffsetSearchRange;
+    std::unordered_map<std::string, std::vector<std::pair<std::string, AATransitionIndividualSettingsForLabel>>> mByAALabel; // label -> [(first_leaf_seq_id, settings)] in by_aa_label order
+
+}; // class AATransitionPerBranchCompiled
+
+// ----------------------------------------------------------------------
+
 class AATransitionDrawSettings : public acmacs::settings::v1::object
 {
  public:
@@ -260,6 +279,8 @@ class TreeDrawSettings : public acmacs::settings::v1::object
     acmacs::settings::v1::field<std::string>                        color_nodes{this, "color_nodes", "continent"};    // black, continent, position number (e.g. 162)
     acmacs::settings::v1::field<std::map<std::string, std::string>> color_for_aa{this, "color_for_aa"};            // for "color_nodes": "<position-number>"
     acmacs::settings::v1::field<double>                             right_padding{this, "right_padding", 0.0};       // padding at the right to add space for the mark_with_line (for BVic del and triple-del mutants)
+    acmacs::settings::v1::field<double>                             collapse_threshold{this, "collapse_threshold", 0.0}; // subtrees whose leaves span less than threshold (in pixels) are drawn as wedges, 0 - never collapse
+    acmacs::settings::v1::field<bool>                               collapse_keep_marked{this, "collapse_keep_marked", true}; // do not collapse subtrees having leaves marked with line or label
     acmacs::settings::v1::field_object<AATransitionDrawSettings>    aa_transition{this, "aa_transition"};
     acmacs::settings::v1::field_object<LegendSettings>              legend{this, "legend"};
 
@@ -345,6 +366,7 @@ class HzSections : public acmacs::settings::v1::object
     acmacs::settings::v1::array_element<HzSection> add(std::string_view aa_transition, bool show_line);
     auto find_section(std::string_view seq_id) const { return sections.find_if([&seq_id](const auto& sect) { return sect.name == std::string{seq_id}; }); }
     auto find_section(std::string_view seq_id)  { return sections.find_if([&seq_id](const auto& sect) { return sect.name == std::string{seq_id}; }); }
+    std::optional<size_t> section_index(std::string_view seq_id) const; // index is made by sort()
 
     size_t shown_maps() const
         {
@@ -353,6 +375,11 @@ class HzSections : public acmacs::settings::v1::object
             return result;
         }
 
+ private:
+    std::unordered_map<std::string, size_t> mSectionIndex; // section name (first seq_id) -> index in sections
+
+    void make_section_index();
+
 }; // class HzSections
 
 // ----------------------------------------------------------------------
@@ -363,8 +390,11 @@ class TreeDraw
     TreeDraw(SignaturePageDraw& aSignaturePageDraw, acmacs::surface::Surface& aSurface, Tree& aTree, TreeDrawSettings& aSettings, HzSections& aHzSections);
     ~TreeDraw();
 
+    void prepare_sections(); // ladderizes tree and makes hz sections final, called by prepare() unless called before
     void prepare();
+    void prepare_draw();
     void draw();
+    void preview(double aDevicePixel) { mPreviewPixel = aDevicePixel; } // before prepare()
 
     const Legend* coloring_legend() const;
     const Coloring& coloring() const { return *mColoring; }
@@ -394,14 +424,40 @@ class TreeDraw
         bool operator<(const AA_Transition& rhs) const { return origin.y() < rhs.origin.y(); }
     };
 
+    struct Label                // text collected by draw_node(), drawn after tree edges
+    {
+        acmacs::PointCoordinates origin;
+        std::string text;
+        Color color;
+        Scaled size;
+        acmacs::TextStyle style;
+    };
+
+    struct CompiledSettings     // typed snapshot of mSettings read per node, made by prepare_draw()
+    {
+        Color line_color = BLACK;
+        acmacs::TextStyle label_style;
+        bool aa_transition_show = false;
+        size_t aa_transition_number_strains_threshold = 0;
+        bool aa_transition_show_empty_left = false;
+        bool show_node_for_left_line = false;
+        Color node_for_left_line_color = BLACK;
+        double node_for_left_line_width = 1;
+        std::optional<AATransitionPerBranchCompiled> aa_transition_per_branch;
+    };
+
     SignaturePageDraw& mSignaturePageDraw;
     acmacs::surface::Surface& mSurface;
     Tree& mTree;
     TreeDrawSettings& mSettings;
+    CompiledSettings mCompiled;
     HzSections& mHzSections;
     std::unique_ptr<Coloring> mColoring;
     mutable std::unique_ptr<Legend> mColoringLegend;
     std::vector<AA_Transition> aa_transitions_;
+    LineBatch mLines;           // tree edges, aa transition connection lines, mark with line, mark with label lines
+    std::vector<Label> mLabels; // leaf names, collapsed subtree and aa transition labels, mark with label, drawn over mLines
+    std::optional<LabelPlacement> mLabelPlacement; // aa transition labels, if scatter_label_offset > 0
 
     double mHorizontalStep;
     double mVerticalStep;
@@ -409,22 +465,31 @@ class TreeDraw
     Scaled mFontSize;
     double mNameOffset;
     bool mInitializeSettings = false;
+    std::optional<size_t> mNumberOfHzSections; // set by prepare_sections()
+    double mPreviewPixel = 0;   // size of the preview device pixel in surface pixels, 0 - not a preview
+    bool mDrawLeafLabels = true; // false in preview if labels are too small to be legible
     std::optional<std::tuple<size_t, std::string>> last_marked_with_label_;
 
     bool apply_mods();          // returns if nodes were hidden
     void set_vertical_pos();
+    void collapse_subtrees();
     size_t prepare_hz_sections();
     void draw_node(const Node& aNode, double aOriginX, double& aVerticalGap, double aEdgeLength = -1);
+    void draw_collapsed(const Node& aNode, double aLeft);
+    void add_label(const acmacs::PointCoordinates& aOrigin, std::string_view aText, Color aColor, Scaled aSize, const acmacs::TextStyle& aStyle) { mLabels.push_back({aOrigin, std::string{aText}, aColor, aSize, aStyle}); }
+    void draw_labels();
+    void add_label_obstacles(const Node& aNode, double aOriginX, double aEdgeLength = -1);
     void draw_legend();
     void draw_aa_transition(const Node& aNode, const acmacs::PointCoordinates& aOrigin, double aRight);
     void draw_mark_with_label(const Node& aNode, const acmacs::PointCoordinates& aTextOrigin);
     void report_aa_transitions();
 
+    void compile_settings();
     void fit_labels_into_viewport();
     void calculate_name_offset();
+    void measure_labels();
 
-    double text_width(std::string_view text) { return mSurface.text_size(text, mFontSize, mSettings.label_style).width; }
-    double max_label_offset();
+    double max_label_offset() const;
 
     void make_coloring();
 
@@ -1,16 +1,22 @@
+#include <filesystem>
+
 #include "acmacs-base/json-writer.hh"
 #include "acmacs-base/json-reader.hh"
 namespace jsw = json_writer;
 
+#include "acmacs-base/fmt.hh"
 #include "acmacs-base/enumerate.hh"
 #include "acmacs-base/read-file.hh"
+#include "acmacs-base/acmacsd.hh"
 #include "signature-page/tree-export.hh"
 #include "signature-page/tree.hh"
+#include "signature-page/file-content.hh"
 
 // ----------------------------------------------------------------------
 
 static constexpr const char* TREE_NEWICK_VERSION = "newick-tree-v1";
 static constexpr const char* TREE_PHYLOGENETIC_VERSION = "phylogenetic-tree-v2";
+static constexpr const char* TREE_PHYLOGENETIC_V3_VERSION = "phylogenetic-tree-v3";
 
 // ----------------------------------------------------------------------
 
@@ -18,6 +24,7 @@ enum class TreeJsonKey : char
 {
     Subtree='t', SeqId='n', EdgeLength='l',
     CumulativeEdgeLength='c', AASequence='a', NucSequence='N', Country='C', Continent='D', Date='d', HiNames='h', // phylogenetic-tree-v3
+    Clades='L', Location='o', // phylogenetic-tree-v3
 
     Unknown='?'
 };
@@ -52,6 +59,50 @@ template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writ
 
 // ----------------------------------------------------------------------
 
+struct NodeWithSeqdbData { const Node& node; };
+struct TreeWithSeqdbData { const Tree& tree; };
+
+template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, NodeWithSeqdbData aNode)
+{
+    const auto& node = aNode.node;
+    writer << jsw::start_object
+           << jsw::if_not_empty(TreeJsonKey::SeqId, node.seq_id)
+           << jsw::if_non_negative(TreeJsonKey::EdgeLength, node.edge_length);
+    if (node.is_leaf()) {
+        auto to_strings = [](const std::vector<std::string_view>* source) {
+            std::vector<std::string> result;
+            if (source)
+                std::transform(source->begin(), source->end(), std::back_inserter(result), [](std::string_view src) { return std::string{src}; });
+            return result;
+        };
+        writer << jsw::if_not_empty(TreeJsonKey::Date, std::string{node.data.date()})
+               << jsw::if_not_empty(TreeJsonKey::AASequence, std::string{node.data.amino_acids()})
+               << jsw::if_not_empty(TreeJsonKey::Country, std::string{node.data.country()})
+               << jsw::if_not_empty(TreeJsonKey::Location, node.data.location())
+               << jsw::if_not_empty(TreeJsonKey::Continent, node.data.continent)
+               << jsw::if_not_empty(TreeJsonKey::Clades, to_strings(node.data.clades()))
+               << jsw::if_not_empty(TreeJsonKey::HiNames, to_strings(node.data.hi_names()));
+    }
+    if (!node.subtree.empty()) {
+        writer << TreeJsonKey::Subtree << jsw::start_array;
+        for (const auto& subnode : node.subtree)
+            writer << NodeWithSeqdbData{subnode};
+        writer << jsw::end_array;
+    }
+    return writer << jsw::end_object;
+}
+
+template <typename RW> inline jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, TreeWithSeqdbData aTree)
+{
+    return writer << jsw::start_object
+                  << jsw::key("  version") << TREE_PHYLOGENETIC_V3_VERSION
+                  << jsw::key("seqdb") << tree::seqdb_stamp()
+                  << jsw::key("tree") << NodeWithSeqdbData{aTree.tree}
+                  << jsw::end_object;
+}
+
+// ----------------------------------------------------------------------
+
 void tree::export_to_json(std::string_view aFilename, const Tree& aTree, size_t aIndent)
 {
     jsw::export_to_json(aTree, std::string(aFilename), aIndent);
@@ -60,6 +111,14 @@ void tree::export_to_json(std::string_view aFilename, const Tree& aTree, size_t
 
 // ----------------------------------------------------------------------
 
+void tree::export_to_json_with_seqdb_data(std::string_view aFilename, const Tree& aTree, size_t aIndent)
+{
+    jsw::export_to_json(TreeWithSeqdbData{aTree}, std::string(aFilename), aIndent);
+
+} // tree::export_to_json_with_seqdb_data
+
+// ----------------------------------------------------------------------
+
 using HandlerBase = json_reader::HandlerBase<Node>;
 
 // ----------------------------------------------------------------------
@@ -101,8 +160,10 @@ class NewickNodeHandler : public HandlerBase
                 case TreeJsonKey::Country:
                 case TreeJsonKey::Continent:
                 case TreeJsonKey::Date:
+                case TreeJsonKey::Location:
                     break;
                 case TreeJsonKey::HiNames:
+                case TreeJsonKey::Clades:
                     result = new StringListIgnoreHandler<Node>(mTarget);
                     break;
                 case TreeJsonKey::Subtree:
@@ -133,8 +194,10 @@ class NewickNodeHandler : public HandlerBase
             case TreeJsonKey::Country:
             case TreeJsonKey::Continent:
             case TreeJsonKey::Date:
+            case TreeJsonKey::Location:
             case TreeJsonKey::SeqId:
                 case TreeJsonKey::HiNames:
+            case TreeJsonKey::Clades:
             case TreeJsonKey::Subtree:
             case TreeJsonKey::Unknown:
                 throw json_reader::Failure();
@@ -153,11 +216,13 @@ class NewickNodeHandler : public HandlerBase
             case TreeJsonKey::Country:
             case TreeJsonKey::Continent:
             case TreeJsonKey::Date:
+            case TreeJsonKey::Location:
                 break;
             case TreeJsonKey::EdgeLength:
             case TreeJsonKey::CumulativeEdgeLength:
             case TreeJsonKey::Subtree:
                 case TreeJsonKey::HiNames:
+            case TreeJsonKey::Clades:
             case TreeJsonKey::Unknown:
                 throw json_reader::Failure();
         }
@@ -239,13 +304,133 @@ class PhylogeneticV2Handler : public HandlerBase
 
 // ----------------------------------------------------------------------
 
+class StringListInternHandler : public json_reader::GenericListHandler<Node>
+{
+  public:
+    StringListInternHandler(Node& aTarget, std::vector<std::string_view>& aList) : json_reader::GenericListHandler<Node>(aTarget, 0), mList(aList) {}
+
+    HandlerBase* String(const char* str, rapidjson::SizeType length) override
+    {
+        mList.push_back(NodeData::intern(std::string_view(str, length)));
+        return nullptr;
+    }
+
+  protected:
+    size_t size() const override { return mList.size(); }
+
+  private:
+    std::vector<std::string_view>& mList;
+
+}; // class StringListInternHandler
+
+// ----------------------------------------------------------------------
+
+class PhylogeneticV3Handler : public HandlerBase
+{
+  public:
+    PhylogeneticV3Handler(Node& aTarget) : HandlerBase(aTarget), mKey(TreeJsonKey::Unknown) {}
+
+    HandlerBase* Key(const char* str, rapidjson::SizeType length) override
+    {
+        HandlerBase* result = nullptr;
+        if (length == 1) {
+            mKey = static_cast<TreeJsonKey>(*str);
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+#endif
+            switch (mKey) {
+                case TreeJsonKey::EdgeLength:
+                case TreeJsonKey::SeqId:
+                case TreeJsonKey::AASequence:
+                case TreeJsonKey::Country:
+                case TreeJsonKey::Location:
+                case TreeJsonKey::Continent:
+                case TreeJsonKey::Date:
+                    break;
+                case TreeJsonKey::Clades:
+                    result = new StringListInternHandler(mTarget, mTarget.data.imported().clades);
+                    break;
+                case TreeJsonKey::HiNames:
+                    result = new StringListInternHandler(mTarget, mTarget.data.imported().hi_names);
+                    break;
+                case TreeJsonKey::Subtree:
+                    result = new json_reader::ListHandler<Node, Node, PhylogeneticV3Handler>(mTarget, mTarget.subtree);
+                    break;
+                default:
+                    result = HandlerBase::Key(str, length);
+                    break;
+            }
+#pragma GCC diagnostic pop
+        }
+        else {
+            result = HandlerBase::Key(str, length);
+        }
+        return result;
+    }
+
+    HandlerBase* Double(double d) override
+    {
+        if (mKey != TreeJsonKey::EdgeLength)
+            throw json_reader::Failure();
+        mTarget.edge_length = d;
+        return nullptr;
+    }
+
+    HandlerBase* String(const char* str, rapidjson::SizeType length) override
+    {
+        const std::string_view value(str, length);
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+#endif
+        switch (mKey) {
+            case TreeJsonKey::SeqId:
+                mTarget.seq_id.assign(value);
+                break;
+            case TreeJsonKey::Date:
+                mTarget.data.imported().date = NodeData::intern(value);
+                break;
+            case TreeJsonKey::AASequence:
+                mTarget.data.imported().amino_acids = NodeData::intern(value);
+                break;
+            case TreeJsonKey::Country:
+                mTarget.data.imported().country = NodeData::intern(value);
+                break;
+            case TreeJsonKey::Location:
+                mTarget.data.imported().location = NodeData::intern(value);
+                break;
+            case TreeJsonKey::Continent:
+                mTarget.data.continent.assign(value);
+                break;
+            default:
+                throw json_reader::Failure();
+        }
+#pragma GCC diagnostic pop
+        return nullptr;
+    }
+
+  private:
+    TreeJsonKey mKey;
+
+    PhylogeneticV3Handler(Node&, Node& aTarget) // for json_reader::ListHandler
+        : HandlerBase(aTarget), mKey(TreeJsonKey::Unknown)
+    {
+    }
+
+    friend class json_reader::ListHandler<Node, Node, PhylogeneticV3Handler>;
+};
+
+// ----------------------------------------------------------------------
+
 class TreeRootHandler : public HandlerBase
 {
   private:
-    enum class Keys { Unknown, Version, Tree };
-    enum class TreeType { Unknown, Newick, PhylogeneticV2 };
+    enum class Keys { Unknown, Version, Tree, Seqdb };
+    enum class TreeType { Unknown, Newick, PhylogeneticV2, PhylogeneticV3 };
 
   public:
+    // aTree is Tree, see tree::tree_import(std::string_view, Tree&)
     TreeRootHandler(Node& aTree) : HandlerBase{aTree}, mKey(Keys::Unknown), mTreeType(TreeType::Unknown) {}
 
     HandlerBase* Key(const char* str, rapidjson::SizeType length) override
@@ -258,6 +443,9 @@ class TreeRootHandler : public HandlerBase
         else if (found_key == "tree") {
             mKey = Keys::Tree;
         }
+        else if (found_key == "seqdb") {
+            mKey = Keys::Seqdb;
+        }
         else {
             result = HandlerBase::Key(str, length);
         }
@@ -275,11 +463,17 @@ class TreeRootHandler : public HandlerBase
                 else if (!strncmp(str, TREE_PHYLOGENETIC_VERSION, std::min(length, static_cast<rapidjson::SizeType>(strlen(TREE_PHYLOGENETIC_VERSION))))) {
                     mTreeType = TreeType::PhylogeneticV2;
                 }
+                else if (!strncmp(str, TREE_PHYLOGENETIC_V3_VERSION, std::min(length, static_cast<rapidjson::SizeType>(strlen(TREE_PHYLOGENETIC_V3_VERSION))))) {
+                    mTreeType = TreeType::PhylogeneticV3;
+                }
                 else {
                     std::cerr << "ERROR: Unsupported version: \"" << std::string(str, length) << '"' << '\n';
                     throw json_reader::Failure();
                 }
                 break;
+            case Keys::Seqdb:
+                static_cast<Tree&>(mTarget).seqdb_stamp.assign(str, length);
+                break;
             case Keys::Tree:
             case Keys::Unknown:
                 result = HandlerBase::String(str, length);
@@ -299,12 +493,16 @@ class TreeRootHandler : public HandlerBase
                     case TreeType::PhylogeneticV2:
                         result = new PhylogeneticV2Handler(mTarget);
                         break;
+                    case TreeType::PhylogeneticV3:
+                        result = new PhylogeneticV3Handler(mTarget);
+                        break;
                     case TreeType::Unknown:
                         throw json_reader::Failure();
                 }
                 break;
             case Keys::Unknown:
             case Keys::Version:
+            case Keys::Seqdb:
                 result = HandlerBase::StartObject();
                 break;
         }
@@ -336,11 +534,123 @@ Tree tree::tree_import(std::string_view aFilename)
 
 // ----------------------------------------------------------------------
 
+static std::string& seqdb_filename()
+{
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wexit-time-destructors"
+#endif
+    static std::string filename;
+#pragma GCC diagnostic pop
+    return filename;
+}
+
+void tree::seqdb_setup(std::string_view seqdb_filename)
+{
+    acmacs::seqdb::setup(seqdb_filename);
+    ::seqdb_filename().assign(seqdb_filename);
+
+} // tree::seqdb_setup
+
+// ----------------------------------------------------------------------
+
+std::string tree::seqdb_stamp()
+{
+    if (const auto& filename = seqdb_filename(); !filename.empty())
+        return file_stamp(filename);
+    else
+        return file_stamp(acmacs::acmacsd_root() + "/data/seqdb.json.xz");
+
+} // tree::seqdb_stamp
+
+// ----------------------------------------------------------------------
+
+std::string tree::file_stamp(std::string_view filename)
+{
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(filename, ec);
+    if (ec)
+        return {};
+    const auto mtime = std::filesystem::last_write_time(filename, ec);
+    if (ec)
+        return {};
+    return fmt::format("{} {} {}", std::filesystem::path(filename).filename().string(), size, std::chrono::duration_cast<std::chrono::seconds>(mtime.time_since_epoch()).count());
+
+} // tree::file_stamp
+
+// ----------------------------------------------------------------------
+
+static void match_seqdb_or_use_sidecar(Tree& aTree, std::string_view aTreeFilename);
+
+void tree::match_seqdb(Tree& aTree, std::string_view aTreeFilename)
+{
+    match_seqdb_or_use_sidecar(aTree, aTreeFilename);
+    aTree.set_categories();
+    aTree.set_dates();
+
+} // tree::match_seqdb
+
+// ----------------------------------------------------------------------
+
+void match_seqdb_or_use_sidecar(Tree& aTree, std::string_view aTreeFilename)
+{
+    if (!aTree.seqdb_stamp.empty()) { // phylogenetic-tree-v3
+        aTree.match_seqdb();
+        return;
+    }
+
+    const auto stamp = tree::seqdb_stamp();
+    const auto sidecar_filename = fmt::format("{}.seqdb.json.xz", aTreeFilename);
+    const auto leaves = aTree.leaf_nodes();
+
+    if (!stamp.empty() && std::filesystem::exists(sidecar_filename)) {
+        try {
+            Tree sidecar;
+            tree::tree_import(sidecar_filename, sidecar);
+            if (sidecar.seqdb_stamp == stamp && sidecar.subtree.size() == leaves.size()) {
+                std::map<std::string_view, const Node*> sidecar_leaves;
+                for (const auto& leaf : sidecar.subtree)
+                    sidecar_leaves.emplace(leaf.seq_id, &leaf);
+                if (std::all_of(leaves.begin(), leaves.end(), [&sidecar_leaves](const Node* leaf) { return sidecar_leaves.find(leaf->seq_id) != sidecar_leaves.end(); })) {
+                    tree::iterate_leaf(aTree, [&sidecar_leaves](Node& leaf) { leaf.data = sidecar_leaves.find(leaf.seq_id)->second->data; });
+                    aTree.seqdb_stamp = stamp;
+                    fmt::print("INFO: seqdb data for {} leaves read from {}\n", leaves.size(), sidecar_filename);
+                    return;
+                }
+            }
+            fmt::print("INFO: {} is outdated\n", sidecar_filename);
+        }
+        catch (std::exception& err) {
+            fmt::print(stderr, "WARNING: cannot read {}: {}\n", sidecar_filename, err.what());
+        }
+    }
+
+    aTree.match_seqdb();
+
+    if (!stamp.empty()) {
+        Tree sidecar; // leaves only
+        for (const auto* leaf : leaves)
+            sidecar.subtree.push_back(*leaf);
+        try {
+              // several sigp --batch jobs may use the same tree at the same time
+            file_content::write_replacing(sidecar_filename, [&sidecar](std::string_view temp_filename) { tree::export_to_json_with_seqdb_data(temp_filename, sidecar, 0); });
+            aTree.seqdb_stamp = stamp;
+            fmt::print("INFO: seqdb data for {} leaves written to {}\n", leaves.size(), sidecar_filename);
+        }
+        catch (std::exception& err) {
+            fmt::print(stderr, "WARNING: cannot write {}: {}\n", sidecar_filename, err.what());
+        }
+    }
+
+} // match_seqdb_or_use_sidecar
+
+// ----------------------------------------------------------------------
+
 Tree tree::tree_import(std::string_view aFilename, std::shared_ptr<acmacs::chart::Chart> chart, Tree::LadderizeMethod aLadderizeMethod)
 {
     Tree tree;
     tree_import(aFilename, tree);
-    tree.match_seqdb();
+    match_seqdb(tree, aFilename);
     if (chart) {
         const auto matched_names = tree.match(*chart);
         if (matched_names)
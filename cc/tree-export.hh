@@ -13,10 +13,23 @@ namespace acmacs::chart { class Chart; }
 namespace tree
 {
     void export_to_json(std::string_view aFilename, const Tree& aTree, size_t aIndent);
+    // phylogenetic-tree-v3: tree with dates, aa sequences, clades, countries and hi names of leaves, tree can be used without seqdb
+    void export_to_json_with_seqdb_data(std::string_view aFilename, const Tree& aTree, size_t aIndent);
     void export_to_newick(std::string_view aFilename, const Tree& aTree, size_t aIndent);
     void tree_import(std::string_view aFilename, Tree& aTree);
     Tree tree_import(std::string_view aFilename);
     Tree tree_import(std::string_view aFilename, std::shared_ptr<acmacs::chart::Chart> chart, Tree::LadderizeMethod aLadderizeMethod = Tree::LadderizeMethod::NumberOfLeaves);
+
+    // acmacs::seqdb::setup() and remember seqdb filename to check if phylogenetic-tree-v3 data is current, seqdb is not loaded
+    void seqdb_setup(std::string_view seqdb_filename);
+    // filename, size and modification time of seqdb, empty if seqdb file not found
+    std::string seqdb_stamp();
+    // filename, size and modification time, empty if file not found
+    std::string file_stamp(std::string_view filename);
+
+    // uses seqdb data of the tree leaves from the sidecar file (aTreeFilename + ".seqdb.json.xz") if it was made from the current seqdb for the same set of leaves,
+    // otherwise matches seqdb and rebuilds the sidecar file
+    void match_seqdb(Tree& aTree, std::string_view aTreeFilename);
 }
 
 // ----------------------------------------------------------------------
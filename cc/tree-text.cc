@@ -32,7 +32,7 @@ int main(int argc, const char* argv[])
     using namespace std::string_literals;
     try {
         Options opt(argc, argv);
-        acmacs::seqdb::setup(opt.seqdb);
+        tree::seqdb_setup(opt.seqdb);
 
         std::shared_ptr<acmacs::chart::Chart> chart;
         if (!opt.chart->empty())
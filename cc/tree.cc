@@ -1,16 +1,132 @@
 #include <iomanip>
+#include <set>
+#include <numeric>
+#include <filesystem>
+#include <cstdlib>
+#include <sstream>
 
 #include "acmacs-base/float.hh"
 #include "acmacs-base/fmt.hh"
+#include "acmacs-base/read-file.hh"
+#include "acmacs-base/acmacsd.hh"
 #include "acmacs-virus/virus-name-v1.hh"
 #include "acmacs-chart-2/chart.hh"
 #include "locationdb/locdb.hh"
 #include "signature-page/tree.hh"
+#include "signature-page/tree-export.hh"
+#include "signature-page/file-content.hh"
+
+// ----------------------------------------------------------------------
+
+// location -> continent, memoized per process and stored on disk for the current version of locationdb.
+// The stamp is made of the file locationdb is set up to load, if that file is not found, the disk cache is not used.
+
+class LocationContinent
+{
+  public:
+    static constexpr const char* Unknown = "UNKNOWN";
+
+    static LocationContinent& get()
+    {
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wexit-time-destructors"
+#endif
+        static LocationContinent location_continent;
+#pragma GCC diagnostic pop
+        return location_continent;
+    }
+
+    std::string_view find(std::string_view location)
+    {
+        if (const auto found = mData.find(location); found != mData.end())
+            return found->second;
+        mModified = true;
+        return mData.emplace(location, acmacs::locationdb::get().continent(location, Unknown)).first->second;
+    }
+
+    void save();
+
+  private:
+    std::string mStamp;
+    std::string mFilename;
+    std::map<std::string, std::string, std::less<>> mData;
+    bool mModified = false;
+
+    LocationContinent();
+};
+
+// ----------------------------------------------------------------------
+
+LocationContinent::LocationContinent()
+{
+    std::error_code ec;
+    if (const auto locdb_filename = std::filesystem::canonical(acmacs::acmacsd_root() + "/data/locationdb.json.xz", ec); !ec) { // symlink to the current version is resolved
+        acmacs::locationdb::setup(locdb_filename.string()); // locationdb is loaded on the first cache miss, make sure it is the stamped file
+        if (const auto stamp = tree::file_stamp(locdb_filename.string()); !stamp.empty())
+            mStamp = fmt::format("{} {}", locdb_filename.parent_path().string(), stamp);
+    }
+    else
+        fmt::print(stderr, "WARNING: locationdb not found in {}/data, location-continent cache is not used\n", acmacs::acmacsd_root());
+
+    if (const char* home = std::getenv("HOME"); home && !mStamp.empty()) {
+        mFilename = fmt::format("{}/.cache/signature-page/location-continent.tsv", home);
+        try {
+            if (std::filesystem::exists(mFilename)) {
+                std::istringstream content{acmacs::file::read(mFilename)};
+                if (std::string line; std::getline(content, line) && line == mStamp) { // otherwise locationdb was updated, cache is invalid
+                    while (std::getline(content, line)) {
+                        if (const auto tab = line.find('\t'); tab != std::string::npos)
+                            mData.emplace(line.substr(0, tab), line.substr(tab + 1));
+                    }
+                }
+            }
+        }
+        catch (std::exception& err) {
+            fmt::print(stderr, "WARNING: cannot read {}: {}\n", mFilename, err.what());
+        }
+    }
+
+} // LocationContinent::LocationContinent
+
+// ----------------------------------------------------------------------
+
+void LocationContinent::save()
+{
+    if (mModified && !mFilename.empty()) {
+        try {
+            std::filesystem::create_directories(std::filesystem::path(mFilename).parent_path());
+            std::string content = mStamp + '\n';
+            for (const auto& [location, continent] : mData)
+                content += fmt::format("{}\t{}\n", location, continent);
+            file_content::write_replacing(mFilename, content); // several processes (e.g. sigp --batch jobs) may update the cache at the same time
+            mModified = false;
+        }
+        catch (std::exception& err) {
+            fmt::print(stderr, "WARNING: cannot write {}: {}\n", mFilename, err.what());
+            mFilename.clear();
+        }
+    }
+
+} // LocationContinent::save
 
 // ----------------------------------------------------------------------
 
 void Tree::match_seqdb()
 {
+    if (!seqdb_stamp.empty()) {
+        if (const auto current = tree::seqdb_stamp(); current.empty()) {
+            fmt::print(stderr, "WARNING: seqdb not found, using sequence data stored in the tree exported from seqdb {}\n", seqdb_stamp);
+            return;
+        }
+        else if (current == seqdb_stamp) {
+            fmt::print("INFO: tree contains data of the current seqdb, matching against seqdb skipped\n");
+            return;
+        }
+        else
+            fmt::print(stderr, "WARNING: tree data was exported from seqdb {}, current seqdb: {}, matching against seqdb\n", seqdb_stamp, current);
+    }
+
     if (const auto& seqdb = acmacs::seqdb::get(); !seqdb.empty()) {
         const auto& seq_id_index = seqdb.seq_id_index();
         tree::iterate_leaf(*this, [&seq_id_index](Node& node) {
@@ -31,7 +147,7 @@ void Tree::ladderize(Tree::LadderizeMethod aLadderizeMethod)
 
     auto set_max_edge = [](Node& aNode) {
         aNode.data.ladderize_max_edge_length = aNode.edge_length;
-        aNode.data.ladderize_max_date = aNode.data.date();
+        aNode.data.ladderize_max_date = aNode.data.packed_date;
         aNode.data.ladderize_max_name_alphabetically = aNode.seq_id;
     };
 
@@ -106,14 +222,146 @@ void Tree::set_number_strains()
 
 void Tree::set_continents()
 {
-    // std::cerr << "DEBUG: Tree: set continents" << '\n';
-
-    tree::iterate_leaf(*this, [](Node& aNode) { aNode.data.set_continent(aNode.seq_id); });
+    if (mContinentsSet)
+        return;
+
+    auto& location_continent = LocationContinent::get();
+    std::map<std::string, size_t> unresolved; // location -> number of leaves
+    std::vector<std::string_view> unrecognized;
+    tree::iterate_leaf(*this, [&](Node& aNode) {
+        if (aNode.data.continent.empty())
+            aNode.data.continent = aNode.data.seqdb_continent();
+        if (aNode.data.continent.empty()) {
+            try {
+                const auto location = virus_name::location(aNode.seq_id);
+                aNode.data.continent = location_continent.find(location);
+                if (aNode.data.continent == LocationContinent::Unknown)
+                    ++unresolved[std::string{location}];
+            }
+            catch (virus_name::Unrecognized&) {
+                aNode.data.continent = LocationContinent::Unknown;
+                unrecognized.push_back(aNode.seq_id);
+            }
+        }
+        aNode.data.continent_id = continents.add(aNode.data.continent);
+    });
+    location_continent.save();
+    mContinentsSet = true;
+
+    if (!unresolved.empty() || !unrecognized.empty()) {
+        fmt::print(stderr, "WARNING: continent not found for {} leaves\n", std::accumulate(unresolved.begin(), unresolved.end(), unrecognized.size(), [](size_t sum, const auto& entry) { return sum + entry.second; }));
+        for (const auto& [location, leaves] : unresolved)
+            fmt::print(stderr, "    location not in locationdb: {:30s} leaves: {}\n", location, leaves);
+        for (const auto& seq_id : unrecognized)
+            fmt::print(stderr, "    location not recognized in name: {}\n", seq_id);
+    }
 
 } // Tree::set_continents
 
 // ----------------------------------------------------------------------
 
+void Tree::set_categories()
+{
+    auto leaf = [this](Node& aNode) {
+        aNode.data.country_id = countries.add(aNode.data.country());
+        aNode.data.location_id = locations.add(aNode.data.location());
+        aNode.data.clade_mask.clear();
+        if (const auto* node_clades = aNode.data.clades(); node_clades) {
+            for (const auto& clade : *node_clades) {
+                if (const auto clade_id = clades.add(clade); clade_id != Categories::NoId) {
+                    if (aNode.data.clade_mask.size() <= clade_id)
+                        aNode.data.clade_mask.resize(clade_id + 1, false);
+                    aNode.data.clade_mask[clade_id] = true;
+                }
+            }
+        }
+    };
+
+    auto parent = [](Node& aNode) {
+        auto& mask = aNode.data.clade_mask;
+        mask.clear();
+        for (const auto& subnode : aNode.subtree) {
+            const auto& submask = subnode.data.clade_mask;
+            if (mask.size() < submask.size())
+                mask.resize(submask.size(), false);
+            for (size_t clade_id = 0; clade_id < submask.size(); ++clade_id) {
+                if (submask[clade_id])
+                    mask[clade_id] = true;
+            }
+        }
+    };
+
+    tree::iterate_leaf_post(*this, leaf, parent);
+
+} // Tree::set_categories
+
+// ----------------------------------------------------------------------
+
+void Tree::set_dates()
+{
+    tree::iterate_leaf(*this, [](Node& aNode) { aNode.data.packed_date = LeafDate::parse(aNode.data.date()); });
+
+} // Tree::set_dates
+
+// ----------------------------------------------------------------------
+
+static inline int32_t days_from_civil(int year, unsigned month, unsigned day) // http://howardhinnant.github.io/date_algorithms.html
+{
+    year -= month <= 2 ? 1 : 0;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const auto year_of_era = static_cast<unsigned>(year - era * 400);
+    const unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + static_cast<int32_t>(day_of_era) - 719468;
+}
+
+LeafDate LeafDate::parse(std::string_view source)
+{
+    auto number = [source](size_t offset, size_t length) -> int {
+        if (source.size() < offset + length)
+            return -1;
+        int result = 0;
+        for (auto ch : source.substr(offset, length)) {
+            if (ch < '0' || ch > '9')
+                return -1;
+            result = result * 10 + (ch - '0');
+        }
+        return result;
+    };
+
+    LeafDate result;
+    result.source = source;
+    const auto year = number(0, 4);
+    if (year <= 0)
+        return result;
+    const auto month = source.size() > 4 && source[4] == '-' ? number(5, 2) : 0;
+    const auto day = month > 0 && source.size() > 7 && source[7] == '-' ? number(8, 2) : 0;
+    if (month < 0 || month > 12 || day < 0 || day > 31)
+        return result;
+    result.days = days_from_civil(year, month > 0 ? static_cast<unsigned>(month) : 1U, day > 0 ? static_cast<unsigned>(day) : 1U);
+    result.month = year * 12 + (month > 0 ? month - 1 : 0);
+    result.partial = day == 0;
+    return result;
+
+} // LeafDate::parse
+
+// ----------------------------------------------------------------------
+
+Categories::id_t Categories::add(std::string_view name)
+{
+    if (name.empty())
+        return NoId;
+    if (const auto found = mIds.find(name); found != mIds.end())
+        return found->second;
+    const auto id = static_cast<id_t>(mNames.size());
+    mNames.push_back(NodeData::intern(name));
+    mIds.emplace(mNames.back(), id);
+    return id;
+
+} // Categories::add
+
+// ----------------------------------------------------------------------
+
 size_t Tree::height() const
 {
     size_t height = find_last_leaf(*this).draw.line_no;
@@ -127,20 +375,53 @@ size_t Tree::height() const
 
 // ----------------------------------------------------------------------
 
-void NodeData::set_continent(std::string seq_id)
+
+bool NodeData::has_clade(std::string_view clade) const
 {
     if (mSeqdbRef)
-        continent = mSeqdbRef.entry->continent;
-    if (continent.empty()) {
-        try {
-            continent = acmacs::locationdb::get().continent(virus_name::location(seq_id), "UNKNOWN");
-        }
-        catch (virus_name::Unrecognized&) {
-            continent = "UNKNOWN";
-        }
+        return mSeqdbRef.has_clade(acmacs::seqdb::get(), clade);
+    else if (mImported)
+        return std::find(std::begin(mImported->clades), std::end(mImported->clades), clade) != std::end(mImported->clades);
+    else
+        return false;
+
+} // NodeData::has_clade
+
+// ----------------------------------------------------------------------
+
+bool NodeData::matches(const acmacs::seqdb::amino_acid_at_pos1_eq_list_t& list_pos1_aa) const
+{
+    if (mSeqdbRef)
+        return mSeqdbRef.matches(list_pos1_aa);
+    else if (mImported) {
+        const auto aa = mImported->amino_acids;
+        return std::all_of(std::begin(list_pos1_aa), std::end(list_pos1_aa), [aa](const auto& pos1_aa) {
+            const auto& [pos1, amino_acid, equal] = pos1_aa;
+            const auto pos0 = static_cast<size_t>(*pos1) - 1;
+            return pos0 < aa.size() && (aa[pos0] == amino_acid) == equal;
+        });
     }
+    else
+        return false;
+
+} // NodeData::matches
 
-} // NodeData::set_continent
+// ----------------------------------------------------------------------
+
+std::string_view NodeData::intern(std::string_view source)
+{
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wexit-time-destructors"
+#endif
+    static std::set<std::string, std::less<>> strings;
+#pragma GCC diagnostic pop
+
+    if (const auto found = strings.find(source); found != strings.end())
+        return *found;
+    return *strings.emplace(source).first;
+
+} // NodeData::intern
 
 // ----------------------------------------------------------------------
 
@@ -369,10 +650,34 @@ void Tree::make_aa_transitions(const std::vector<size_t>& aPositions)
     };
     tree::iterate_leaf_pre(*this, add_left_part, add_left_part);
 
+    mNodesByAATransition.clear();
+    tree::iterate_pre(*this, [this](const Node& aNode) {
+        for (const auto& transition : aNode.data.aa_transitions)
+            mNodesByAATransition[transition.code()].push_back(&aNode);
+    });
+
 } // Tree::make_aa_transitions
 
 // ----------------------------------------------------------------------
 
+const std::vector<const Node*>& Tree::nodes_with_aa_transition(std::string_view aDisplayName) const
+{
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wexit-time-destructors"
+#endif
+    static const std::vector<const Node*> not_found;
+#pragma GCC diagnostic pop
+    if (const auto code = AA_Transition::code(aDisplayName); code) {
+        if (const auto found = mNodesByAATransition.find(*code); found != mNodesByAATransition.end())
+            return found->second;
+    }
+    return not_found;
+
+} // Tree::nodes_with_aa_transition
+
+// ----------------------------------------------------------------------
+
 size_t Tree::longest_aa() const
 {
     size_t longest_aa = 0;
@@ -452,13 +757,14 @@ const Node* Tree::find_next_leaf(const Node& previous_leaf, bool shown_only) con
 
 void Tree::sequences_per_month(std::map<date::year_month_day, size_t>& spm) const
 {
-    auto worker = [&spm](const Node& aNode) -> void {
-        const auto d = aNode.data.date();
-        if (!d.empty() && aNode.draw.shown) {
-            ++spm[date::beginning_of_month(date::from_string(d, date::allow_incomplete::yes))];
-        }
+    std::map<int32_t, size_t> per_month;
+    auto worker = [&per_month](const Node& aNode) -> void {
+        if (aNode.draw.shown && aNode.data.packed_date.known())
+            ++per_month[aNode.data.packed_date.month];
     };
     tree::iterate_leaf(*this, worker);
+    for (const auto& [month, count] : per_month)
+        spm[date::year_month_day{date::year{month / 12}, date::month{static_cast<unsigned>(month % 12 + 1)}, date::day{1}}] += count;
 
 } // Tree::sequences_per_month
 
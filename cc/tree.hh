@@ -5,8 +5,10 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <optional>
+#include <limits>
 
 #include "acmacs-base/date.hh"
 #include "acmacs-base/color-modifier.hh"
@@ -21,45 +23,121 @@ namespace acmacs::chart { class Chart; }
 
 // ----------------------------------------------------------------------
 
+// Names of categorical attributes of leaves (clades, countries, locations, continents) mapped to small integer ids, see Tree::set_categories()
+class Categories
+{
+ public:
+    using id_t = uint32_t;
+    constexpr static const id_t NoId = static_cast<id_t>(-1);
+
+    id_t add(std::string_view name); // returns NoId for empty name
+    id_t find(std::string_view name) const { if (const auto found = mIds.find(name); found != mIds.end()) return found->second; else return NoId; }
+    std::string_view name(id_t id) const { return mNames[id]; }
+    size_t size() const { return mNames.size(); }
+
+ private:
+    std::vector<std::string_view> mNames; // interned, see NodeData::intern()
+    std::map<std::string_view, id_t> mIds;
+
+}; // class Categories
+
+// ----------------------------------------------------------------------
+
+// Date of a leaf parsed once, see Tree::set_dates()
+struct LeafDate
+{
+    constexpr static const int32_t Unknown = std::numeric_limits<int32_t>::min();
+
+    int32_t days = Unknown;  // since 1970-01-01, for partial dates: the first day of the month (year)
+    int32_t month = Unknown; // year * 12 + month - 1, year only dates are in January (as date::from_string(allow_incomplete) makes them)
+    bool partial = false;    // day (and month) is missing
+    std::string_view source; // date() the value was parsed from
+
+    bool known() const { return days != Unknown; }
+
+      // the same order as comparing source strings (used for ladderizing before dates were parsed):
+      // partial dates ("2019", "2019-03", "2019-03-00") go before complete dates of the same first day, ties are resolved by source
+    bool operator<(const LeafDate& rhs) const
+    {
+        if (days != rhs.days)
+            return days < rhs.days;
+        if (partial != rhs.partial)
+            return partial;
+        return source < rhs.source;
+    }
+    bool operator==(const LeafDate& rhs) const { return days == rhs.days && partial == rhs.partial && source == rhs.source; }
+
+    static LeafDate parse(std::string_view source); // YYYY-MM-DD, YYYY-MM-00, YYYY-MM, YYYY
+
+}; // struct LeafDate
+
+// ----------------------------------------------------------------------
+
 // SeqDb and HiDb access data
 class NodeData
 {
  public:
     NodeData() = default;
 
-    bool has_sequence() const { return static_cast<bool>(mSeqdbRef); }
-
-    std::string_view date() const { return has_sequence() ? mSeqdbRef.entry->date() : std::string_view{}; }
-    std::string_view amino_acids() const { return has_sequence() ? mSeqdbRef.aa_aligned(acmacs::seqdb::get()) : std::string_view{}; }
-    const std::vector<std::string_view>* clades() const { return has_sequence() ? &mSeqdbRef.seq().clades : nullptr; }
-    bool has_clade(std::string_view clade) const { return has_sequence() && mSeqdbRef.has_clade(acmacs::seqdb::get(), clade); }
-    std::string_view country() const { return has_sequence() ? mSeqdbRef.entry->country : std::string_view{}; }
-    std::string location() const { return has_sequence() ? mSeqdbRef.entry->location() : std::string{}; }
-    bool matches(const acmacs::seqdb::amino_acid_at_pos1_eq_list_t& list_pos1_aa) const { return has_sequence() && mSeqdbRef.matches(list_pos1_aa); }
-    const std::vector<std::string_view>* hi_names() const { return has_sequence() ? &mSeqdbRef.seq().hi_names : nullptr; }
+    // seqdb data read from phylogenetic-tree-v3 (see tree-export.cc), used if there is no seqdb reference, strings are interned (see intern())
+    struct Imported
+    {
+        std::string_view date;
+        std::string_view amino_acids;
+        std::string_view country;
+        std::string_view location;
+        std::vector<std::string_view> clades;
+        std::vector<std::string_view> hi_names;
+    };
+
+    bool has_sequence() const { return static_cast<bool>(mSeqdbRef) || mImported.has_value(); }
+    bool has_seqdb_ref() const { return static_cast<bool>(mSeqdbRef); }
+
+    std::string_view date() const { return mSeqdbRef ? mSeqdbRef.entry->date() : (mImported ? mImported->date : std::string_view{}); }
+    std::string_view amino_acids() const { return mSeqdbRef ? mSeqdbRef.aa_aligned(acmacs::seqdb::get()) : (mImported ? mImported->amino_acids : std::string_view{}); }
+    const std::vector<std::string_view>* clades() const { return mSeqdbRef ? &mSeqdbRef.seq().clades : (mImported ? &mImported->clades : nullptr); }
+    bool has_clade(std::string_view clade) const;
+    std::string_view country() const { return mSeqdbRef ? mSeqdbRef.entry->country : (mImported ? mImported->country : std::string_view{}); }
+    std::string location() const { return mSeqdbRef ? mSeqdbRef.entry->location() : (mImported ? std::string{mImported->location} : std::string{}); }
+    bool matches(const acmacs::seqdb::amino_acid_at_pos1_eq_list_t& list_pos1_aa) const;
+    const std::vector<std::string_view>* hi_names() const { return mSeqdbRef ? &mSeqdbRef.seq().hi_names : (mImported ? &mImported->hi_names : nullptr); }
 
     void assign(const acmacs::seqdb::ref& ref) { mSeqdbRef = ref; }
-    void set_continent(std::string seq_id);
+    Imported& imported() { if (!mImported) mImported.emplace(); return *mImported; }
+    std::string_view seqdb_continent() const { return mSeqdbRef ? std::string_view{mSeqdbRef.entry->continent} : std::string_view{}; }
+
+    static std::string_view intern(std::string_view source); // returns view to the copy of source kept until the end of the program
 
+    LeafDate packed_date; // date() parsed in Tree::set_dates()
     size_t number_strains = 1;
     double ladderize_max_edge_length = 0;
-    std::string ladderize_max_date;
+    LeafDate ladderize_max_date;
     std::string ladderize_max_name_alphabetically;
     double cumulative_edge_length = -1;
     double distance_from_previous = -1; // for hz sections auto-detection
     std::string continent;
 
+    // ids in Tree categories, set by Tree::set_categories() and Tree::set_continents()
+    Categories::id_t country_id = Categories::NoId;
+    Categories::id_t location_id = Categories::NoId;
+    Categories::id_t continent_id = Categories::NoId;
+    std::vector<bool> clade_mask; // indexed by clade id, for parent nodes: union of the subtree masks
+    bool has_clade(Categories::id_t clade_id) const { return clade_id < clade_mask.size() && clade_mask[clade_id]; }
+
     std::string aa_at;          // see make_aa_at()
     AA_Transitions aa_transitions;
 
  private:
     acmacs::seqdb::ref mSeqdbRef;
+    std::optional<Imported> mImported;
 
 }; // class NodeData
 
 // ----------------------------------------------------------------------
 
 //  drawing related stuff
+class Node;
+
 class NodeDrawData
 {
  public:
@@ -76,6 +154,19 @@ class NodeDrawData
     std::optional<size_t> chart_antigen_index;
     size_t matched_antigens = 0; // for parent nodes only
     std::optional<size_t> mark_with_label;
+    std::string label;         // display_name(), cached in TreeDraw::measure_labels()
+    double label_width = 0;    // per unit of font size
+    double label_height = 0;   // per unit of font size
+
+    struct Collapsed            // subtree drawn as a wedge, see TreeDraw::collapse_subtrees()
+    {
+        size_t leaves = 0;      // shown leaves
+        double top = 0;         // vertical_pos of the first shown leaf
+        double bottom = 0;      // vertical_pos of the last shown leaf
+        double depth = 0;       // max edge length from the node to its shown leaves
+    };
+    std::optional<Collapsed> collapsed;
+    const Node* collapsed_into = nullptr; // for nodes inside collapsed subtree
 
 }; // class NodeDrawData
 
@@ -153,13 +244,17 @@ class Tree : public Node
 
     Tree() = default;
 
-    void match_seqdb();
+    void match_seqdb(); // does nothing if tree was imported with the data of the current seqdb (phylogenetic-tree-v3)
     void ladderize(LadderizeMethod aLadderizeMethod);
 
     void set_number_strains();
-    void set_continents();
+    void set_categories(); // clades, countries, locations, must be called after matching seqdb
+    void set_dates();      // must be called after matching seqdb
+    void set_continents(); // location -> continent resolution is memoized per process and cached on disk, see tree.cc
     void make_aa_transitions(); // for all positions
     void make_aa_transitions(const std::vector<size_t>& aPositions);
+      // nodes having aa transition with the passed display name (e.g. N145K) in pre-order, index is made by make_aa_transitions() and invalidated by ladderize() and re_root()
+    const std::vector<const Node*>& nodes_with_aa_transition(std::string_view aDisplayName) const;
 
     void compute_cumulative_edge_length()
     {
@@ -201,7 +296,7 @@ class Tree : public Node
 
     std::vector<const Node*> leaf_nodes_sorted_by_date() const
     {
-        return leaf_nodes_sorted_by([](const Node* a, const Node* b) -> bool { return a->data.date() < b->data.date(); });
+        return leaf_nodes_sorted_by([](const Node* a, const Node* b) -> bool { return a->data.packed_date < b->data.packed_date; });
     }
 
     std::vector<const Node*> leaf_nodes_sorted_by_distance_from_previous()
@@ -236,8 +331,13 @@ class Tree : public Node
       // returns number of matched antigen names
     size_t match(const acmacs::chart::Chart& chart);
 
+    std::string seqdb_stamp; // phylogenetic-tree-v3: stamp of seqdb the data was exported from, see tree::seqdb_stamp()
+    Categories clades, countries, locations, continents;
+
   private:
     double mMaxCumulativeEdgeLength = -1;
+    bool mContinentsSet = false;
+    std::unordered_map<uint32_t, std::vector<const Node*>> mNodesByAATransition; // AA_Transition::code() -> nodes
 
     size_t longest_aa() const;
     void make_aa_at(const std::vector<size_t>& aPositions);